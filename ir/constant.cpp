@@ -2,6 +2,7 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "ir/constant.h"
+#include "ir/interp.h"
 #include "smt/expr.h"
 #include "util/compiler.h"
 #include <cassert>
@@ -35,6 +36,29 @@ pair<expr, expr> IntConst::toSMT_cnst() const {
   return { expr::mkInt(get<string>(val).c_str(), bits()), true };
 }
 
+static APInt int_value(const variant<int64_t, string> &val, unsigned bw) {
+  if (auto v = get_if<int64_t>(&val)) {
+    APInt r(64, *v);
+    return bw <= 64 ? r.extract(bw-1, 0) : r.sext(bw - 64);
+  }
+
+  APInt r(bw), ten(bw, 10);
+  for (auto c : get<string>(val)) {
+    if (c < '0' || c > '9')
+      throw UnsupportedEval();
+    r = r * ten + APInt(bw, c - '0');
+  }
+  return r;
+}
+
+ConcreteVal IntConst::eval(Interpreter &s) const {
+  return { int_value(val, bits()) };
+}
+
+SlicedVal IntConst::evalSliced(SlicedInterpreter &s) const {
+  return { BitSlice::splat(int_value(val, bits())) };
+}
+
 expr IntConst::getTypeConstraints() const {
   unsigned min_bits = 0;
   if (auto v = get_if<int64_t>(&val))
@@ -111,6 +135,20 @@ pair<expr, expr> ConstantInput::toSMT_cnst() const {
   return { expr::mkVar(getName().c_str(), bits()), true };
 }
 
+ConcreteVal ConstantInput::eval(Interpreter &s) const {
+  auto &v = s.getInput(getName());
+  if (v.bits() != bits())
+    throw UnsupportedEval();
+  return { APInt(v) };
+}
+
+SlicedVal ConstantInput::evalSliced(SlicedInterpreter &s) const {
+  auto &v = s.getInput(getName());
+  if (v.v.bits() != bits())
+    throw UnsupportedEval();
+  return v;
+}
+
 
 ConstantBinOp::ConstantBinOp(Type &type, Constant &lhs, Constant &rhs, Op op)
   : Constant(type, ""), lhs(lhs), rhs(rhs), op(op) {
@@ -157,6 +195,45 @@ pair<expr, expr> ConstantBinOp::toSMT_cnst() const {
   return { move(val), move(ub) };
 }
 
+ConcreteVal ConstantBinOp::eval(Interpreter &s) const {
+  auto &a = s[lhs].v;
+  auto &b = s[rhs].v;
+  auto bw = bits();
+
+  switch (op) {
+  case ADD: return { a + b };
+  case SUB: return { a - b };
+  case SDIV:
+    if (b.isZero() || (a == APInt(bw, 1).shl(bw-1) && b.isAllOnes()))
+      s.addUB();
+    return { a.sdiv(b) };
+  case UDIV:
+    if (b.isZero())
+      s.addUB();
+    return { a.udiv(b) };
+  }
+  UNREACHABLE();
+}
+
+SlicedVal ConstantBinOp::evalSliced(SlicedInterpreter &s) const {
+  auto &a = s[lhs].v;
+  auto &b = s[rhs].v;
+  auto bw = bits();
+
+  switch (op) {
+  case ADD: return { a + b };
+  case SUB: return { a - b };
+  case SDIV:
+    s.addUB(b.isZero() | (a.eq(BitSlice::splat(APInt(bw, 1).shl(bw-1))) &
+                          b.eq(BitSlice::splat(APInt::allOnes(bw)))));
+    return { a.sdiv(b) };
+  case UDIV:
+    s.addUB(b.isZero());
+    return { a.udiv(b) };
+  }
+  UNREACHABLE();
+}
+
 expr ConstantBinOp::getTypeConstraints() const {
   return Value::getTypeConstraints() &&
          getType().enforceIntType() &&
@@ -29,6 +29,8 @@ public:
   IntConst(Type &type, int64_t val);
   IntConst(Type &type, std::string &&val);
   std::pair<smt::expr, smt::expr> toSMT_cnst() const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints() const override;
   auto getInt() const { return std::get_if<int64_t>(&val); }
 };
@@ -60,6 +62,8 @@ public:
   ConstantInput(Type &type, std::string &&name)
     : Constant(type, std::move(name)) {}
   std::pair<smt::expr, smt::expr> toSMT_cnst() const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
 };
 
 
@@ -74,6 +78,8 @@ private:
 public:
   ConstantBinOp(Type &type, Constant &lhs, Constant &rhs, Op op);
   std::pair<smt::expr, smt::expr> toSMT_cnst() const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints() const override;
 };
 
@@ -3,6 +3,9 @@
 
 #include "ir/function.h"
 #include "ir/instr.h"
+#include "util/compiler.h"
+#include <cassert>
+#include <set>
 
 using namespace smt;
 using namespace std;
@@ -60,6 +63,26 @@ expr Function::getTypeConstraints() const {
   return t;
 }
 
+expr Function::getTypeCost() const {
+  // values often share a type; count each type once to keep the sum small
+  set<const Type*> types = { &getType() };
+  for (auto &i : instrs()) {
+    types.emplace(&i.getType());
+  }
+  for (auto &l : { getConstants(), getInputs(), getUndefs() }) {
+    for (auto &v : l) {
+      types.emplace(&v.getType());
+    }
+  }
+
+  expr c = getType().getCost();
+  for (auto *ty : types) {
+    if (ty != &getType())
+      c = c + ty->getCost();
+  }
+  return c;
+}
+
 void Function::fixupTypes(const Model &m) {
   for (auto bb : getBBs()) {
     bb->fixupTypes(m);
@@ -71,6 +94,72 @@ void Function::fixupTypes(const Model &m) {
   }
 }
 
+static unique_ptr<Value> dup_constant(const Value &v) {
+  if (auto c = dynamic_cast<const PoisonValue*>(&v))
+    return make_unique<PoisonValue>(*c);
+  if (auto c = dynamic_cast<const IntConst*>(&v))
+    return make_unique<IntConst>(*c);
+  if (auto c = dynamic_cast<const FloatConst*>(&v))
+    return make_unique<FloatConst>(*c);
+  if (auto c = dynamic_cast<const ConstantInput*>(&v))
+    return make_unique<ConstantInput>(*c);
+  // TODO: constants that refer to other values
+  UNREACHABLE();
+}
+
+Function Function::dup(TypeCopies &types) const {
+  // TODO: preconditions and jumps
+  assert(!precondition);
+
+  Function f;
+  if (type)
+    f.type = &types[*type];
+  f.name = name;
+
+  // the copy of each value; their operands are replaced once all exist
+  unordered_map<const Value*, Value*> copies;
+  auto add = [&](const Value &from, Value &to) {
+    to.type = &types[*from.type];
+    copies.emplace(&from, &to);
+  };
+
+  for (auto &i : inputs) {
+    auto input = make_unique<Input>(static_cast<const Input&>(*i));
+    add(*i, *input);
+    f.addInput(move(input));
+  }
+  for (auto &u : undefs) {
+    auto undef = make_unique<UndefValue>(static_cast<const UndefValue&>(*u));
+    add(*u, *undef);
+    f.addUndef(move(undef));
+  }
+  for (auto &c : constants) {
+    auto cnst = dup_constant(*c);
+    add(*c, *cnst);
+    f.addConstant(move(cnst));
+  }
+
+  vector<pair<const Instr*, Instr*>> new_instrs;
+  for (auto bb : BB_order) {
+    auto &new_bb = f.getBB(bb->getName());
+    for (auto &i : bb->instrs()) {
+      assert(!dynamic_cast<const JumpInstr*>(&i));
+      auto instr = i.dup("");
+      add(i, *instr);
+      new_instrs.emplace_back(&i, instr.get());
+      new_bb.addInstr(move(instr));
+    }
+  }
+
+  for (auto &[from, to] : new_instrs) {
+    for (auto *op : from->operands()) {
+      if (auto I = copies.find(op); I != copies.end())
+        to->rauw(*op, *I->second);
+    }
+  }
+  return f;
+}
+
 BasicBlock& Function::getBB(string_view name) {
   auto p = BBs.try_emplace(string(name), name);
   if (p.second)
@@ -164,6 +253,27 @@ ostream& operator<<(ostream &os, const Function &f) {
 }
 
 
+unordered_set<const Instr*> relevant_instrs(const Function &f) {
+  unordered_set<const Instr*> relevant;
+  vector<const Instr*> worklist;
+  for (auto &i : f.instrs()) {
+    if (i.hasSideEffects() && relevant.emplace(&i).second)
+      worklist.emplace_back(&i);
+  }
+
+  while (!worklist.empty()) {
+    auto *i = worklist.back();
+    worklist.pop_back();
+    for (auto *op : i->operands()) {
+      auto *op_i = dynamic_cast<const Instr*>(op);
+      if (op_i && relevant.emplace(op_i).second)
+        worklist.emplace_back(op_i);
+    }
+  }
+  return relevant;
+}
+
+
 void CFG::edge_iterator::next() {
   // jump to next BB with a terminator that is a jump
   while (true) {
@@ -14,6 +14,7 @@
 #include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace smt { class Model; }
@@ -74,6 +75,8 @@ public:
   const std::string& getName() const { return name; }
 
   smt::expr getTypeConstraints() const;
+  // sum of the costs of the types of all values; see Type::getCost()
+  smt::expr getTypeCost() const;
   void fixupTypes(const smt::Model &m);
 
   const BasicBlock& getFirstBB() const { return *BB_order[0]; }
@@ -99,6 +102,10 @@ public:
 
   bool hasReturn() const;
 
+  // A copy of this function with the types in 'types', so that the copy can
+  // be fixed up independently; see TypeCopies
+  Function dup(TypeCopies &types) const;
+
   auto& getBBs() { return BB_order; }
   const auto& getBBs() const { return BB_order; }
 
@@ -130,6 +137,11 @@ public:
 };
 
 
+// The instructions with side effects (see Instr::hasSideEffects()) and those
+// they depend on. The others can't change the return value, UB, or the memory.
+std::unordered_set<const Instr*> relevant_instrs(const Function &f);
+
+
 class CFG final {
   Function &f;
 
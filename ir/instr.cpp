@@ -3,6 +3,7 @@
 
 #include "ir/instr.h"
 #include "ir/function.h"
+#include "ir/interp.h"
 #include "ir/type.h"
 #include "smt/expr.h"
 #include "smt/solver.h"
@@ -11,6 +12,8 @@
 
 using namespace smt;
 using namespace std;
+using util::APInt;
+using util::BitSlice;
 
 #define RAUW(val)    \
   if (val == &what)  \
@@ -83,6 +86,11 @@ void BinOp::rauw(const Value &what, Value &with) {
   RAUW(rhs);
 }
 
+bool BinOp::hasSideEffects() const {
+  // division by zero is UB
+  return op == SDiv || op == UDiv || op == SRem || op == URem;
+}
+
 void BinOp::print(ostream &os) const {
   const char *str = nullptr;
   switch (op) {
@@ -350,6 +358,305 @@ StateValue BinOp::toSMT(State &s) const {
   return { move(val), move(not_poison) };
 }
 
+static APInt smin(unsigned bw) {
+  return APInt(bw, 1).shl(bw - 1);
+}
+
+static void div_ub(Interpreter &s, const APInt &a, const APInt &b, bool ap,
+                   bool bp, bool sign) {
+  if (bp || b.isZero() ||
+      (sign && (ap || a == smin(b.bits())) && b.isAllOnes()))
+    s.addUB();
+}
+
+ConcreteVal BinOp::eval(Interpreter &s) const {
+  auto &[a, ap] = s[*lhs];
+  auto &[b, bp] = s[*rhs];
+  auto bw = a.bits();
+  APInt val(bw);
+  bool poison = ap || bp;
+
+  switch (op) {
+  case Add:
+    val = a + b;
+    if (flags & NSW)
+      poison |= a.sext(1) + b.sext(1) != val.sext(1);
+    if (flags & NUW)
+      poison |= val.ult(a);
+    break;
+
+  case Sub:
+    val = a - b;
+    if (flags & NSW)
+      poison |= a.sext(1) - b.sext(1) != val.sext(1);
+    if (flags & NUW)
+      poison |= a.ult(b);
+    break;
+
+  case Mul:
+    val = a * b;
+    if (flags & NSW)
+      poison |= a.sext(bw) * b.sext(bw) != val.sext(bw);
+    if (flags & NUW)
+      poison |= a.zext(bw) * b.zext(bw) != val.zext(bw);
+    break;
+
+  case SDiv:
+    val = a.sdiv(b);
+    div_ub(s, a, b, ap, bp, true);
+    if (flags & Exact)
+      poison |= val * b != a;
+    break;
+
+  case UDiv:
+    val = a.udiv(b);
+    div_ub(s, a, b, ap, bp, false);
+    if (flags & Exact)
+      poison |= val * b != a;
+    break;
+
+  case SRem:
+    val = a.srem(b);
+    div_ub(s, a, b, ap, bp, true);
+    break;
+
+  case URem:
+    val = a.urem(b);
+    div_ub(s, a, b, ap, bp, false);
+    break;
+
+  case Shl:
+    val = a.shl(b);
+    poison |= !b.ult(APInt(bw, bw));
+    if (flags & NSW)
+      poison |= val.ashr(b) != a;
+    if (flags & NUW)
+      poison |= val.lshr(b) != a;
+    break;
+
+  case AShr:
+    val = a.ashr(b);
+    poison |= !b.ult(APInt(bw, bw));
+    if (flags & Exact)
+      poison |= val.shl(b) != a;
+    break;
+
+  case LShr:
+    val = a.lshr(b);
+    poison |= !b.ult(APInt(bw, bw));
+    if (flags & Exact)
+      poison |= val.shl(b) != a;
+    break;
+
+  case SAdd_Sat:
+  case SSub_Sat: {
+    auto ext = op == SAdd_Sat ? a.sext(1) + b.sext(1) : a.sext(1) - b.sext(1);
+    auto min = smin(bw), max = ~min;
+    if (ext.sle(min.sext(1)))
+      val = min;
+    else if (max.sext(1).sle(ext))
+      val = max;
+    else
+      val = ext.extract(bw - 1, 0);
+    break;
+  }
+  case UAdd_Sat:
+    val = a + b;
+    if (val.ult(a))
+      val = APInt::allOnes(bw);
+    break;
+
+  case USub_Sat:
+    val = a.ule(b) ? APInt(bw) : a - b;
+    break;
+
+  case And:
+    val = a & b;
+    break;
+
+  case Or:
+    val = a | b;
+    break;
+
+  case Xor:
+    val = a ^ b;
+    break;
+
+  case Cttz:
+    val = APInt(bw, a.countTrailingZeros());
+    poison |= !b.isZero() && a.isZero();
+    break;
+
+  case Ctlz:
+    val = APInt(bw, a.countLeadingZeros());
+    poison |= !b.isZero() && a.isZero();
+    break;
+
+  case SAdd_Overflow:
+  case UAdd_Overflow:
+  case SSub_Overflow:
+  case USub_Overflow:
+  case SMul_Overflow:
+  case UMul_Overflow:
+  case FAdd:
+  case FSub:
+  case FMul:
+  case FDiv:
+  case FRem:
+    throw UnsupportedEval();
+  }
+
+  return { move(val), poison };
+}
+
+static uint64_t div_ub(const BitSlice &a, const BitSlice &b, uint64_t ap,
+                       uint64_t bp, bool sign) {
+  auto bw = b.bits();
+  uint64_t ub = bp | b.isZero();
+  if (sign)
+    ub |= (ap | a.eq(BitSlice::splat(smin(bw)))) &
+          b.eq(BitSlice::splat(APInt::allOnes(bw)));
+  return ub;
+}
+
+SlicedVal BinOp::evalSliced(SlicedInterpreter &s) const {
+  auto &[a, ap] = s[*lhs];
+  auto &[b, bp] = s[*rhs];
+  auto bw = a.bits();
+  BitSlice val(bw);
+  uint64_t poison = ap | bp;
+  auto out_of_range = [&]() { return ~b.ult(BitSlice::splat(APInt(bw, bw))); };
+
+  switch (op) {
+  case Add:
+    val = a + b;
+    if (flags & NSW)
+      poison |= ~(a.sext(1) + b.sext(1)).eq(val.sext(1));
+    if (flags & NUW)
+      poison |= val.ult(a);
+    break;
+
+  case Sub:
+    val = a - b;
+    if (flags & NSW)
+      poison |= ~(a.sext(1) - b.sext(1)).eq(val.sext(1));
+    if (flags & NUW)
+      poison |= a.ult(b);
+    break;
+
+  case Mul:
+    val = a * b;
+    if (flags & NSW)
+      poison |= ~(a.sext(bw) * b.sext(bw)).eq(val.sext(bw));
+    if (flags & NUW)
+      poison |= ~(a.zext(bw) * b.zext(bw)).eq(val.zext(bw));
+    break;
+
+  case SDiv:
+    val = a.sdiv(b);
+    s.addUB(div_ub(a, b, ap, bp, true));
+    if (flags & Exact)
+      poison |= ~(val * b).eq(a);
+    break;
+
+  case UDiv:
+    val = a.udiv(b);
+    s.addUB(div_ub(a, b, ap, bp, false));
+    if (flags & Exact)
+      poison |= ~(val * b).eq(a);
+    break;
+
+  case SRem:
+    val = a.srem(b);
+    s.addUB(div_ub(a, b, ap, bp, true));
+    break;
+
+  case URem:
+    val = a.urem(b);
+    s.addUB(div_ub(a, b, ap, bp, false));
+    break;
+
+  case Shl:
+    val = a.shl(b);
+    poison |= out_of_range();
+    if (flags & NSW)
+      poison |= ~val.ashr(b).eq(a);
+    if (flags & NUW)
+      poison |= ~val.lshr(b).eq(a);
+    break;
+
+  case AShr:
+    val = a.ashr(b);
+    poison |= out_of_range();
+    if (flags & Exact)
+      poison |= ~val.shl(b).eq(a);
+    break;
+
+  case LShr:
+    val = a.lshr(b);
+    poison |= out_of_range();
+    if (flags & Exact)
+      poison |= ~val.shl(b).eq(a);
+    break;
+
+  case SAdd_Sat:
+  case SSub_Sat: {
+    auto ext = op == SAdd_Sat ? a.sext(1) + b.sext(1) : a.sext(1) - b.sext(1);
+    auto min = BitSlice::splat(smin(bw)), max = ~min;
+    val = BitSlice::select(ext.sle(min.sext(1)), min,
+            BitSlice::select(max.sext(1).sle(ext), max,
+                             ext.extract(bw - 1, 0)));
+    break;
+  }
+  case UAdd_Sat:
+    val = a + b;
+    val = BitSlice::select(val.ult(a), BitSlice::splat(APInt::allOnes(bw)),
+                           val);
+    break;
+
+  case USub_Sat:
+    val = BitSlice::select(a.ule(b), BitSlice(bw), a - b);
+    break;
+
+  case And:
+    val = a & b;
+    break;
+
+  case Or:
+    val = a | b;
+    break;
+
+  case Xor:
+    val = a ^ b;
+    break;
+
+  case Cttz:
+    val = a.countTrailingZeros();
+    poison |= ~b.isZero() & a.isZero();
+    break;
+
+  case Ctlz:
+    val = a.countLeadingZeros();
+    poison |= ~b.isZero() & a.isZero();
+    break;
+
+  case SAdd_Overflow:
+  case UAdd_Overflow:
+  case SSub_Overflow:
+  case USub_Overflow:
+  case SMul_Overflow:
+  case UMul_Overflow:
+  case FAdd:
+  case FSub:
+  case FMul:
+  case FDiv:
+  case FRem:
+    throw UnsupportedEval();
+  }
+
+  return { move(val), poison };
+}
+
 expr BinOp::getTypeConstraints(const Function &f) const {
   expr instrconstr;
   switch (op) {
@@ -443,6 +750,32 @@ StateValue UnaryOp::toSMT(State &s) const {
   return { move(newval), expr(vp) };
 }
 
+ConcreteVal UnaryOp::eval(Interpreter &s) const {
+  auto &[v, vp] = s[*val];
+
+  switch (op) {
+  case Copy:       return { APInt(v), vp };
+  case BitReverse: return { v.bitreverse(), vp };
+  case BSwap:      return { v.bswap(), vp };
+  case Ctpop:      return { APInt(v.bits(), v.popcount()), vp };
+  case FNeg:       throw UnsupportedEval();
+  }
+  UNREACHABLE();
+}
+
+SlicedVal UnaryOp::evalSliced(SlicedInterpreter &s) const {
+  auto &[v, vp] = s[*val];
+
+  switch (op) {
+  case Copy:       return { BitSlice(v), vp };
+  case BitReverse: return { v.bitreverse(), vp };
+  case BSwap:      return { v.bswap(), vp };
+  case Ctpop:      return { v.popcount(), vp };
+  case FNeg:       throw UnsupportedEval();
+  }
+  UNREACHABLE();
+}
+
 expr UnaryOp::getTypeConstraints(const Function &f) const {
   expr instrconstr = true;
   switch(op) {
@@ -512,6 +845,42 @@ StateValue TernaryOp::toSMT(State &s) const {
   return { move(newval), move(not_poison) };
 }
 
+ConcreteVal TernaryOp::eval(Interpreter &s) const {
+  auto &[av, ap] = s[*a];
+  auto &[bv, bp] = s[*b];
+  auto &[cv, cp] = s[*c];
+  auto nbits = av.bits();
+  auto c_mod_width = cv.urem(APInt(nbits, nbits)).zext(nbits);
+  bool poison = ap || bp || cp;
+
+  switch (op) {
+  case FShl:
+    return { av.concat(bv).shl(c_mod_width).extract(2 * nbits - 1, nbits),
+             poison };
+  case FShr:
+    return { av.concat(bv).lshr(c_mod_width).extract(nbits - 1, 0), poison };
+  }
+  UNREACHABLE();
+}
+
+SlicedVal TernaryOp::evalSliced(SlicedInterpreter &s) const {
+  auto &[av, ap] = s[*a];
+  auto &[bv, bp] = s[*b];
+  auto &[cv, cp] = s[*c];
+  auto nbits = av.bits();
+  auto c_mod_width = cv.urem(BitSlice::splat(APInt(nbits, nbits))).zext(nbits);
+  uint64_t poison = ap | bp | cp;
+
+  switch (op) {
+  case FShl:
+    return { av.concat(bv).shl(c_mod_width).extract(2 * nbits - 1, nbits),
+             poison };
+  case FShr:
+    return { av.concat(bv).lshr(c_mod_width).extract(nbits - 1, 0), poison };
+  }
+  UNREACHABLE();
+}
+
 expr TernaryOp::getTypeConstraints(const Function &f) const {
   return Value::getTypeConstraints() &&
          getType().enforceIntOrVectorType() &&
@@ -588,6 +957,40 @@ StateValue ConversionOp::toSMT(State &s) const {
   return { move(newval), expr(vp) };
 }
 
+ConcreteVal ConversionOp::eval(Interpreter &s) const {
+  auto &[v, vp] = s[*val];
+  auto to_bw = getType().bits();
+
+  switch (op) {
+  case SExt:  return { v.sext(to_bw - v.bits()), vp };
+  case ZExt:  return { v.zext(to_bw - v.bits()), vp };
+  case Trunc: return { v.extract(to_bw - 1, 0), vp };
+  case BitCast:
+    // operands are ints (or the interpreter would have given up already)
+    return { APInt(v), vp };
+  case Ptr2Int:
+  case Int2Ptr:
+    throw UnsupportedEval();
+  }
+  UNREACHABLE();
+}
+
+SlicedVal ConversionOp::evalSliced(SlicedInterpreter &s) const {
+  auto &[v, vp] = s[*val];
+  auto to_bw = getType().bits();
+
+  switch (op) {
+  case SExt:    return { v.sext(to_bw - v.bits()), vp };
+  case ZExt:    return { v.zext(to_bw - v.bits()), vp };
+  case Trunc:   return { v.extract(to_bw - 1, 0), vp };
+  case BitCast: return { BitSlice(v), vp };
+  case Ptr2Int:
+  case Int2Ptr:
+    throw UnsupportedEval();
+  }
+  UNREACHABLE();
+}
+
 expr ConversionOp::getTypeConstraints(const Function &f) const {
   expr c;
   switch (op) {
@@ -647,6 +1050,20 @@ StateValue Select::toSMT(State &s) const {
            cp && expr::mkIf(cond, ap, bp) };
 }
 
+ConcreteVal Select::eval(Interpreter &s) const {
+  auto &[c, cp] = s[*cond];
+  auto &[v, vp] = s[c.isZero() ? *b : *a];
+  return { APInt(v), cp || vp };
+}
+
+SlicedVal Select::evalSliced(SlicedInterpreter &s) const {
+  auto &[c, cp] = s[*cond];
+  auto &[av, ap] = s[*a];
+  auto &[bv, bp] = s[*b];
+  uint64_t m = c[0];
+  return { BitSlice::select(m, av, bv), cp | (m & ap) | (~m & bp) };
+}
+
 expr Select::getTypeConstraints(const Function &f) const {
   return cond->getType().enforceIntType(1) &&
          Value::getTypeConstraints() &&
@@ -934,6 +1351,50 @@ StateValue ICmp::toSMT(State &s) const {
   return { cmp.value.toBVBool(), move(non_poison) && move(cmp.non_poison) };
 }
 
+ConcreteVal ICmp::eval(Interpreter &s) const {
+  auto &[av, ap] = s[*a];
+  auto &[bv, bp] = s[*b];
+  bool r = false;
+
+  switch (cond) {
+  case EQ:  r = av == bv; break;
+  case NE:  r = av != bv; break;
+  case SLE: r = av.sle(bv); break;
+  case SLT: r = av.slt(bv); break;
+  case SGE: r = bv.sle(av); break;
+  case SGT: r = bv.slt(av); break;
+  case ULE: r = av.ule(bv); break;
+  case ULT: r = av.ult(bv); break;
+  case UGE: r = bv.ule(av); break;
+  case UGT: r = bv.ult(av); break;
+  case Any:
+    throw UnsupportedEval();
+  }
+  return { APInt(1, r), ap || bp };
+}
+
+SlicedVal ICmp::evalSliced(SlicedInterpreter &s) const {
+  auto &[av, ap] = s[*a];
+  auto &[bv, bp] = s[*b];
+  BitSlice r(1);
+
+  switch (cond) {
+  case EQ:  r[0] = av.eq(bv); break;
+  case NE:  r[0] = ~av.eq(bv); break;
+  case SLE: r[0] = av.sle(bv); break;
+  case SLT: r[0] = av.slt(bv); break;
+  case SGE: r[0] = bv.sle(av); break;
+  case SGT: r[0] = bv.slt(av); break;
+  case ULE: r[0] = av.ule(bv); break;
+  case ULT: r[0] = av.ult(bv); break;
+  case UGE: r[0] = bv.ule(av); break;
+  case UGT: r[0] = bv.ult(av); break;
+  case Any:
+    throw UnsupportedEval();
+  }
+  return { move(r), ap | bp };
+}
+
 expr ICmp::getTypeConstraints(const Function &f) const {
   return Value::getTypeConstraints() &&
          getType().enforceIntType(1) &&
@@ -1037,6 +1498,26 @@ StateValue Freeze::toSMT(State &s) const {
   return { expr::mkIf(p, v, move(nondet)), true };
 }
 
+ConcreteVal Freeze::eval(Interpreter &s) const {
+  // any value is fine for a frozen poison; pick zero, as for undef
+  auto &[v, p] = s[*val];
+  // freezing undef picks one value for all uses, which a set can't express
+  if (s.hasChoices())
+    s.addNondet();
+  if (!p)
+    return { APInt(v) };
+  s.addNondet();
+  return { APInt(v.bits()) };
+}
+
+SlicedVal Freeze::evalSliced(SlicedInterpreter &s) const {
+  auto &[v, p] = s[*val];
+  // a lane holds a single value, not the choice of a frozen poison
+  if (p)
+    throw UnsupportedEval();
+  return { BitSlice(v) };
+}
+
 expr Freeze::getTypeConstraints(const Function &f) const {
   return Value::getTypeConstraints() &&
          getType() == val->getType();
@@ -1102,6 +1583,16 @@ StateValue Phi::toSMT(State &s) const {
   return ret;
 }
 
+ConcreteVal Phi::eval(Interpreter &s) const {
+  for (auto &[val, bb] : values) {
+    if (&s.getFn().getBB(bb) == s.prevBB()) {
+      auto &[v, p] = s[*val];
+      return { APInt(v), p };
+    }
+  }
+  throw UnsupportedEval();
+}
+
 expr Phi::getTypeConstraints(const Function &f) const {
   auto c = Value::getTypeConstraints();
   for (auto &[val, bb] : values) {
@@ -1171,6 +1662,19 @@ StateValue Branch::toSMT(State &s) const {
   return {};
 }
 
+ConcreteVal Branch::eval(Interpreter &s) const {
+  if (cond) {
+    auto &[c, cp] = s[*cond];
+    if (cp)
+      s.addUB();
+    else
+      s.addJump(c.isZero() ? *dst_false : dst_true);
+  } else {
+    s.addJump(dst_true);
+  }
+  return { APInt(1), true };
+}
+
 expr Branch::getTypeConstraints(const Function &f) const {
   return cond->getType().enforceIntType(1);
 }
@@ -1227,6 +1731,23 @@ StateValue Switch::toSMT(State &s) const {
   return {};
 }
 
+ConcreteVal Switch::eval(Interpreter &s) const {
+  auto &[v, vp] = s[*value];
+  if (vp) {
+    s.addUB();
+  } else {
+    const BasicBlock *dst = &default_target;
+    for (auto &[value_cond, bb] : targets) {
+      if (s[*value_cond].v == v) {
+        dst = &bb;
+        break;
+      }
+    }
+    s.addJump(*dst);
+  }
+  return { APInt(1), true };
+}
+
 expr Switch::getTypeConstraints(const Function &f) const {
   expr typ = value->getType().enforceIntType();
   for (auto &p : targets) {
@@ -1261,6 +1782,16 @@ StateValue Return::toSMT(State &s) const {
   return {};
 }
 
+ConcreteVal Return::eval(Interpreter &s) const {
+  s.addReturn(s[*val]);
+  return { APInt(1), true };
+}
+
+SlicedVal Return::evalSliced(SlicedInterpreter &s) const {
+  s.addReturn(s[*val]);
+  return { BitSlice(1), UINT64_MAX };
+}
+
 expr Return::getTypeConstraints(const Function &f) const {
   return Value::getTypeConstraints() &&
          getType() == val->getType() &&
@@ -1293,6 +1824,19 @@ StateValue Assume::toSMT(State &s) const {
   return {};
 }
 
+ConcreteVal Assume::eval(Interpreter &s) const {
+  auto &[v, p] = s[*cond];
+  if (if_non_poison ? !p && v.isZero() : p || v.isZero())
+    s.addUB();
+  return { APInt(1), true };
+}
+
+SlicedVal Assume::evalSliced(SlicedInterpreter &s) const {
+  auto &[v, p] = s[*cond];
+  s.addUB(if_non_poison ? ~p & v.isZero() : p | v.isZero());
+  return { BitSlice(1), UINT64_MAX };
+}
+
 expr Assume::getTypeConstraints(const Function &f) const {
   return cond->getType().enforceIntType();
 }
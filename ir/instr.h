@@ -20,6 +20,9 @@ protected:
 public:
   virtual std::vector<Value*> operands() const = 0;
   virtual void rauw(const Value &what, Value &with) = 0;
+  // true if it may be UB, or change the memory or the control flow, so it
+  // matters even if its result is unused
+  virtual bool hasSideEffects() const { return true; }
   virtual smt::expr eqType(const Instr &i) const;
   smt::expr getTypeConstraints() const override;
   virtual smt::expr getTypeConstraints(const Function &f) const = 0;
@@ -49,8 +52,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override;
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -70,8 +76,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -91,8 +100,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -112,8 +124,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -127,8 +142,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -144,6 +162,7 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
@@ -184,8 +203,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -206,6 +228,7 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
@@ -221,8 +244,11 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -237,8 +263,10 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -287,6 +315,7 @@ public:
   void rauw(const Value &what, Value &with) override;
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -312,6 +341,7 @@ public:
   void rauw(const Value &what, Value &with) override;
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -326,6 +356,8 @@ public:
   void rauw(const Value &what, Value &with) override;
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -343,6 +375,8 @@ public:
   void rauw(const Value &what, Value &with) override;
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
   std::unique_ptr<Instr> dup(const std::string &suffix) const override;
 };
@@ -391,6 +425,7 @@ public:
 
   std::vector<Value*> operands() const override;
   void rauw(const Value &what, Value &with) override;
+  bool hasSideEffects() const override { return false; }
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
   smt::expr getTypeConstraints(const Function &f) const override;
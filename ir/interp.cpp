@@ -0,0 +1,222 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "ir/interp.h"
+#include "ir/function.h"
+#include <algorithm>
+
+using namespace std;
+using namespace util;
+
+// default bound on evaluations; there are no loops in the IR we verify, so
+// this stops runaway runs and large sets
+static constexpr unsigned default_max_steps = 1u << 20;
+
+// undef inputs wider than this aren't expanded into sets
+static constexpr unsigned max_undef_bits = 12;
+
+static bool same(const IR::ConcreteVal &a, const IR::ConcreteVal &b) {
+  return a.poison ? b.poison : !b.poison && a.v == b.v;
+}
+
+namespace {
+// the distinct results of an instruction over the combinations of its operands
+class ResultSet {
+  IR::ConcreteSet set;
+  vector<bool> seen; // by value, for narrow types
+  bool has_poison = false;
+
+public:
+  void add(IR::ConcreteVal &&v) {
+    if (v.poison) {
+      if (!has_poison)
+        set.emplace_back(move(v));
+      has_poison = true;
+      return;
+    }
+
+    uint64_t n;
+    if (v.v.bits() <= 16 && v.v.isUInt(n)) {
+      if (seen.empty())
+        seen.resize(1u << v.v.bits());
+      if (!seen[n])
+        set.emplace_back(move(v));
+      seen[n] = true;
+      return;
+    }
+
+    if (none_of(set.begin(), set.end(), [&](auto &r) { return same(r, v); }))
+      set.emplace_back(move(v));
+  }
+
+  IR::ConcreteSet& get() { return set; }
+};
+}
+
+namespace IR {
+
+Interpreter::Interpreter(const Function &f,
+                         const unordered_map<string, APInt> &inputs)
+  : f(f), inputs(inputs), max_steps(default_max_steps) {}
+
+const ConcreteVal& Interpreter::choose(const ConcreteSet &set) {
+  if (next_choice == choices.size())
+    choices.emplace_back(0, set.size());
+  return set[choices[next_choice++].first];
+}
+
+// moves to the next combination of the sets read, in depth-first order;
+// false once every one was evaluated
+bool Interpreter::nextCombination() {
+  while (!choices.empty()) {
+    auto &[idx, size] = choices.back();
+    if (++idx < size)
+      return true;
+    choices.pop_back();
+  }
+  return false;
+}
+
+void Interpreter::run() {
+  const BasicBlock *bb = &f.getFirstBB();
+
+  while (bb) {
+    next_bb = nullptr;
+    for (auto &i : bb->instrs()) {
+      // integers are stored as one APInt, which is wrong for vectors
+      auto &ty = i.getType();
+      if (!ty.isIntType() && !dynamic_cast<const VoidType*>(&ty))
+        throw UnsupportedEval();
+
+      ResultSet result_set;
+      next_choice = 0;
+      result_set.add(i.eval(*this));
+
+      // the sets read by the first combination tell how many there are; give
+      // up now rather than after evaluating them
+      uint64_t combinations = 1;
+      for (auto &[idx, size] : choices) {
+        combinations = min(combinations * size, uint64_t(max_steps) + 1);
+      }
+      steps += min(combinations, uint64_t(max_steps) + 1);
+      if (steps > max_steps)
+        throw UnsupportedEval();
+
+      while (nextCombination()) {
+        next_choice = 0;
+        result_set.add(i.eval(*this));
+      }
+
+      auto &results = result_set.get();
+      if (results.size() == 1)
+        values.insert_or_assign(&i, move(results[0]));
+      else
+        sets.insert_or_assign(&i, move(results));
+
+      // UB doesn't stop the run, as the values after it are checked in
+      // check_each_var mode
+      if (!rets.empty())
+        return;
+      if (next_bb)
+        break;
+    }
+    prev_bb = bb;
+    bb = next_bb;
+  }
+}
+
+const ConcreteVal& Interpreter::operator[](const Value &val) {
+  if (auto I = values.find(&val); I != values.end())
+    return I->second;
+  if (auto I = sets.find(&val); I != sets.end())
+    return choose(I->second);
+
+  // instructions are added by run(); this is a constant or an input
+  if (dynamic_cast<const Instr*>(&val) || !val.getType().isIntType())
+    throw UnsupportedEval();
+
+  if (dynamic_cast<const Input*>(&val) && undef_inputs.count(val.getName())) {
+    auto bits = val.bits();
+    if (bits > max_undef_bits)
+      throw UnsupportedEval();
+    ConcreteSet all;
+    for (uint64_t v = 0, e = 1ull << bits; v != e; ++v) {
+      all.emplace_back(APInt(bits, v));
+    }
+    return choose(sets.emplace(&val, move(all)).first->second);
+  }
+  return values.emplace(&val, val.eval(*this)).first->second;
+}
+
+const ConcreteVal* Interpreter::get(const Value &val) const {
+  auto I = values.find(&val);
+  return I == values.end() ? nullptr : &I->second;
+}
+
+ConcreteSet Interpreter::getAll(const Value &val) const {
+  if (auto I = sets.find(&val); I != sets.end())
+    return I->second;
+  ConcreteSet r;
+  if (auto v = get(val))
+    r.emplace_back(*v);
+  return r;
+}
+
+const APInt& Interpreter::getInput(const string &name) const {
+  auto I = inputs.find(name);
+  if (I == inputs.end())
+    throw UnsupportedEval();
+  return I->second;
+}
+
+void Interpreter::addJump(const BasicBlock &dst) {
+  // a branch on undef would need a set of paths
+  if (next_bb && next_bb != &dst)
+    throw UnsupportedEval();
+  next_bb = &dst;
+}
+
+void Interpreter::addReturn(const ConcreteVal &val) {
+  if (none_of(rets.begin(), rets.end(), [&](auto &r) { return same(r, val); }))
+    rets.emplace_back(val);
+}
+
+
+SlicedInterpreter::SlicedInterpreter(const Function &f,
+                                     const unordered_map<string, SlicedVal> &inputs)
+  : f(f), inputs(inputs) {}
+
+void SlicedInterpreter::run() {
+  if (f.getBBs().size() != 1)
+    throw UnsupportedEval();
+
+  for (auto &i : f.getFirstBB().instrs()) {
+    auto &ty = i.getType();
+    if (!ty.isIntType() && !dynamic_cast<const VoidType*>(&ty))
+      throw UnsupportedEval();
+    values.insert_or_assign(&i, i.evalSliced(*this));
+  }
+}
+
+const SlicedVal& SlicedInterpreter::operator[](const Value &val) {
+  if (auto I = values.find(&val); I != values.end())
+    return I->second;
+
+  if (dynamic_cast<const Instr*>(&val) || !val.getType().isIntType())
+    throw UnsupportedEval();
+  return values.emplace(&val, val.evalSliced(*this)).first->second;
+}
+
+const SlicedVal* SlicedInterpreter::get(const Value &val) const {
+  auto I = values.find(&val);
+  return I == values.end() ? nullptr : &I->second;
+}
+
+const SlicedVal& SlicedInterpreter::getInput(const string &name) const {
+  auto I = inputs.find(name);
+  if (I == inputs.end())
+    throw UnsupportedEval();
+  return I->second;
+}
+
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "util/apint.h"
+#include "util/bitslice.h"
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace IR {
+
+class BasicBlock;
+class Function;
+class Value;
+
+// A concrete value of an integer type; 'v' is meaningless if poison
+struct ConcreteVal {
+  util::APInt v;
+  bool poison = false;
+
+  ConcreteVal(util::APInt &&v, bool poison = false)
+    : v(std::move(v)), poison(poison) {}
+};
+
+// The values a value may take when it depends on undef; no duplicates, and at
+// most one poison
+using ConcreteSet = std::vector<ConcreteVal>;
+
+// Thrown by Value::eval() for values and types the interpreter doesn't
+// support (e.g., floats, pointers, memory), and for runs that don't finish
+struct UnsupportedEval : public std::exception {};
+
+
+// Executes a function on concrete integer inputs, following the semantics of
+// Value::toSMT(). Undef values are taken as zero, and so is the result of a
+// freeze of poison, so runs find candidate counterexamples rather than prove
+// anything; see isNondet().
+// Inputs may also be poison or undef. Like in the SMT encoding, each read of an
+// undef input may see any value, so the values that depend on one are sets:
+// such instructions are evaluated on every combination of their operands.
+class Interpreter {
+  const Function &f;
+  const std::unordered_map<std::string, util::APInt> &inputs;
+  std::unordered_set<std::string> undef_inputs, poison_inputs;
+  std::unordered_map<const Value*, ConcreteVal> values;
+  std::unordered_map<const Value*, ConcreteSet> sets;
+
+  // (index, size) of the elements of sets read by the current evaluation
+  std::vector<std::pair<unsigned, unsigned>> choices;
+  unsigned next_choice = 0;
+  unsigned steps = 0, max_steps;
+
+  const BasicBlock *prev_bb = nullptr, *next_bb = nullptr;
+  ConcreteSet rets;
+  bool ub = false, nondet = false;
+
+  const ConcreteVal& choose(const ConcreteSet &set);
+  bool nextCombination();
+
+public:
+  // 'inputs' has the values of the inputs and constant inputs, by name
+  Interpreter(const Function &f,
+              const std::unordered_map<std::string, util::APInt> &inputs);
+
+  // these inputs don't need a value in 'inputs'
+  void setUndef(const std::string &name) { undef_inputs.emplace(name); }
+  void setPoison(const std::string &name) { poison_inputs.emplace(name); }
+
+  // bound on evaluations, counting each combination of undef values; run()
+  // throws UnsupportedEval past it
+  void setMaxSteps(unsigned n) { max_steps = n; }
+  void run();
+
+  // the value of an operand; constants and inputs are evaluated on demand
+  const ConcreteVal& operator[](const Value &val);
+  // null if 'val' wasn't executed or may take several values
+  const ConcreteVal* get(const Value &val) const;
+  // every value 'val' may take; empty if it wasn't executed
+  ConcreteSet getAll(const Value &val) const;
+  const util::APInt& getInput(const std::string &name) const;
+  bool isPoisonInput(const std::string &name) const {
+    return poison_inputs.count(name);
+  }
+
+  auto& getFn() const { return f; }
+  const BasicBlock* prevBB() const { return prev_bb; }
+  // true if the value being evaluated depends on undef
+  bool hasChoices() const { return !choices.empty(); }
+  // instructions evaluated so far, counting each combination
+  unsigned numSteps() const { return steps; }
+
+  // with undef, these are reached if any combination is
+  void addUB() { ub = true; }
+  // an undef or a frozen poison was taken as zero, or a freeze of undef
+  // couldn't be represented
+  void addNondet() { nondet = true; }
+  void addJump(const BasicBlock &dst);
+  void addReturn(const ConcreteVal &val);
+
+  bool isUB() const { return ub; }
+  bool isNondet() const { return nondet; }
+  // null if the function didn't return or may return several values
+  const ConcreteVal* returnVal() const {
+    return rets.size() == 1 ? &rets[0] : nullptr;
+  }
+  const ConcreteSet& returnVals() const { return rets; }
+};
+
+
+// A value for each lane of a SlicedInterpreter
+struct SlicedVal {
+  util::BitSlice v;
+  uint64_t poison = 0; // mask of the lanes where it's poison
+
+  SlicedVal(util::BitSlice &&v, uint64_t poison = 0)
+    : v(std::move(v)), poison(poison) {}
+};
+
+// Executes a function on 64 assignments of the inputs at once, one per lane,
+// with the same semantics as Interpreter. It handles only functions with a
+// single basic block, and no undef or freeze, so a run is exact: there are no
+// choices to make.
+class SlicedInterpreter {
+  const Function &f;
+  const std::unordered_map<std::string, SlicedVal> &inputs;
+  std::unordered_map<const Value*, SlicedVal> values;
+  const SlicedVal *ret = nullptr;
+  uint64_t ub = 0;
+
+public:
+  SlicedInterpreter(const Function &f,
+                    const std::unordered_map<std::string, SlicedVal> &inputs);
+
+  void run();
+
+  const SlicedVal& operator[](const Value &val);
+  // null if 'val' wasn't executed
+  const SlicedVal* get(const Value &val) const;
+  const SlicedVal& getInput(const std::string &name) const;
+
+  void addUB(uint64_t lanes) { ub |= lanes; }
+  void addReturn(const SlicedVal &val) { ret = &val; }
+
+  // mask of the lanes that hit UB
+  uint64_t getUB() const { return ub; }
+  // null if the function didn't return
+  const SlicedVal* returnVal() const { return ret; }
+};
+
+}
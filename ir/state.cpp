@@ -32,6 +32,13 @@ const StateValue& State::exec(const Value &v) {
   return values.back().second.first;
 }
 
+const StateValue& State::bind(const Value &v, const StateValue &val) {
+  assert(undef_vars.empty());
+  ENSURE(values_map.try_emplace(&v, (unsigned)values.size()).second);
+  values.emplace_back(&v, ValTy(val, {}));
+  return values.back().second.first;
+}
+
 const StateValue& State::operator[](const Value &val) {
   auto &[sval, uvars] = values[values_map.at(&val)].second;
   if (uvars.empty())
@@ -63,6 +70,11 @@ const State::ValTy& State::at(const Value &val) const {
   return values[values_map.at(&val)].second;
 }
 
+const State::ValTy* State::find(const Value &val) const {
+  auto I = values_map.find(&val);
+  return I == values_map.end() ? nullptr : &values[I->second].second;
+}
+
 const expr* State::jumpCondFrom(const BasicBlock &bb) const {
   auto &pres = predecessor_data.at(current_bb);
   auto I = pres.find(&bb);
@@ -63,8 +63,13 @@ public:
   State(const Function &f, bool source);
 
   const StateValue& exec(const Value &v);
+  // binds 'v' to a value of another state instead of executing it, e.g., to
+  // that of an identical instruction of the source; it can't depend on undef
+  const StateValue& bind(const Value &v, const StateValue &val);
   const StateValue& operator[](const Value &val);
   const ValTy& at(const Value &val) const;
+  // null if 'val' wasn't executed
+  const ValTy* find(const Value &val) const;
   const smt::expr* jumpCondFrom(const BasicBlock &bb) const;
 
   bool startBB(const BasicBlock &bb);
@@ -15,6 +15,10 @@ static constexpr unsigned var_type_bits = 3;
 static constexpr unsigned var_bw_bits = 8;
 static constexpr unsigned var_vector_elements = 10;
 
+static constexpr unsigned cost_bits = 16;
+static constexpr unsigned fp_cost = 64;
+static constexpr unsigned aggregate_cost = 128;
+
 
 namespace IR {
 
@@ -29,6 +33,10 @@ expr Type::typeVar() const {
   return var("type", var_type_bits);
 }
 
+expr Type::getCost() const {
+  return expr::mkUInt(0, cost_bits);
+}
+
 expr Type::sizeVar() const {
   return var("bw", var_bw_bits);
 }
@@ -206,6 +214,10 @@ void VoidType::fixup(const Model &m) {
   // do nothing
 }
 
+unique_ptr<Type> VoidType::dup(TypeCopies &copies) const {
+  return nullptr;
+}
+
 pair<expr, vector<expr>> VoidType::mkInput(State &s, const char *name) const {
   UNREACHABLE();
 }
@@ -236,6 +248,10 @@ expr IntType::getTypeConstraints() const {
   return r;
 }
 
+expr IntType::getCost() const {
+  return sizeVar().zext(cost_bits - var_bw_bits);
+}
+
 expr IntType::sizeVar() const {
   return defined ? expr::mkUInt(bits(), var_bw_bits) : Type::sizeVar();
 }
@@ -253,6 +269,10 @@ void IntType::fixup(const Model &m) {
     bitwidth = m.getUInt(sizeVar());
 }
 
+unique_ptr<Type> IntType::dup(TypeCopies &copies) const {
+  return defined ? nullptr : make_unique<IntType>(string(name));
+}
+
 bool IntType::isIntType() const {
   return true;
 }
@@ -317,6 +337,15 @@ expr FloatType::fromBV(expr e) const {
   return e.BV2float(getDummyValue());
 }
 
+expr FloatType::getCost() const {
+  auto bw = sizeVar();
+  auto is = [&](FpType ty) { return bw == expr::mkUInt(ty, var_bw_bits); };
+  return expr::mkUInt(fp_cost, cost_bits) +
+         expr::mkIf(is(Half), expr::mkUInt(16, cost_bits),
+                    expr::mkIf(is(Float), expr::mkUInt(32, cost_bits),
+                               expr::mkUInt(64, cost_bits)));
+}
+
 expr FloatType::sizeVar() const {
   return defined ? expr::mkUInt(getFpType(), var_bw_bits) : Type::sizeVar();
 }
@@ -359,6 +388,10 @@ void FloatType::fixup(const Model &m) {
   fpType = FpType(fp_typ);
 }
 
+unique_ptr<Type> FloatType::dup(TypeCopies &copies) const {
+  return defined ? nullptr : make_unique<FloatType>(string(name));
+}
+
 bool FloatType::isFloatType() const {
   return true;
 }
@@ -429,6 +462,10 @@ expr PtrType::getTypeConstraints() const {
   return sizeVar() == bits();
 }
 
+expr PtrType::getCost() const {
+  return expr::mkUInt(bits(), cost_bits);
+}
+
 expr PtrType::operator==(const PtrType &rhs) const {
   return sizeVar() == rhs.sizeVar() &&
          ASVar() == rhs.ASVar();
@@ -443,6 +480,10 @@ void PtrType::fixup(const Model &m) {
     addr_space = m.getUInt(ASVar());
 }
 
+unique_ptr<Type> PtrType::dup(TypeCopies &copies) const {
+  return defined ? nullptr : make_unique<PtrType>(string(name));
+}
+
 bool PtrType::isPtrType() const {
   return true;
 }
@@ -558,6 +599,12 @@ expr AggregateType::getTypeConstraints() const {
   return r;
 }
 
+expr AggregateType::getCost() const {
+  // the elements aren't counted, as that makes typing queries much slower
+  // for symbolic aggregates
+  return expr::mkUInt(aggregate_cost, cost_bits);
+}
+
 expr AggregateType::operator==(const AggregateType &rhs) const {
   expr elems = numElements();
   expr res = elems == rhs.numElements();
@@ -648,6 +695,10 @@ expr ArrayType::getTypeConstraints() const {
   return false;
 }
 
+unique_ptr<Type> ArrayType::dup(TypeCopies &copies) const {
+  return make_unique<ArrayType>(string(name));
+}
+
 void ArrayType::print(ostream &os) const {
   os << "TODO";
 }
@@ -688,6 +739,16 @@ expr VectorType::enforceIntOrPtrOrVectorType() const {
   return children[0]->enforceIntOrPtrType();
 }
 
+unique_ptr<Type> VectorType::dup(TypeCopies &copies) const {
+  if (!defined)
+    return make_unique<VectorType>(string(name));
+
+  auto &elementTy = copies[*children[0]];
+  if (&elementTy == children[0])
+    return nullptr;
+  return make_unique<VectorType>(string(name), elements, elementTy);
+}
+
 void VectorType::print(ostream &os) const {
   if (elements)
     os << '<' << elements << " x " << *children[0] << '>';
@@ -708,6 +769,21 @@ const StructType* StructType::getAsStructType() const {
   return this;
 }
 
+unique_ptr<Type> StructType::dup(TypeCopies &copies) const {
+  if (!defined)
+    return make_unique<StructType>(string(name));
+
+  bool shared = true;
+  vector<Type*> new_children;
+  for (auto *child : children) {
+    new_children.emplace_back(&copies[*child]);
+    shared &= new_children.back() == child;
+  }
+  if (shared)
+    return nullptr;
+  return make_unique<StructType>(string(name), move(new_children));
+}
+
 void StructType::print(ostream &os) const {
   if (!elements)
     return;
@@ -782,6 +858,16 @@ expr SymbolicType::getTypeConstraints() const {
   return c;
 }
 
+expr SymbolicType::getCost() const {
+  expr r = expr::mkUInt(0, cost_bits);
+  if (s) r = expr::mkIf(isStruct(), s->getCost(), r);
+  if (a) r = expr::mkIf(isArray(), a->getCost(), r);
+  if (p) r = expr::mkIf(isPtr(), p->getCost(), r);
+  if (f) r = expr::mkIf(isFloat(), f->getCost(), r);
+  if (i) r = expr::mkIf(isInt(), i->getCost(), r);
+  return r;
+}
+
 expr SymbolicType::operator==(const Type &b) const {
   if (this == &b)
     return true;
@@ -861,6 +947,13 @@ void SymbolicType::fixup(const Model &m) {
   }
 }
 
+unique_ptr<Type> SymbolicType::dup(TypeCopies &copies) const {
+  unsigned type_mask = (i ? 1 << Int : 0) | (f ? 1 << Float : 0) |
+                       (p ? 1 << Ptr : 0) | (a ? 1 << Array : 0) |
+                       (v ? 1 << Vector : 0) | (s ? 1 << Struct : 0);
+  return make_unique<SymbolicType>(string(name), type_mask);
+}
+
 bool SymbolicType::isIntType() const {
   return typ == Int;
 }
@@ -956,4 +1049,16 @@ void SymbolicType::print(ostream &os) const {
   }
 }
 
+
+
+Type& TypeCopies::operator[](Type &t) {
+  auto I = copies.find(&t);
+  if (I == copies.end()) {
+    // the children are copied first, which may add entries
+    auto copy = t.dup(*this);
+    I = copies.emplace(&t, move(copy)).first;
+  }
+  return I->second ? *I->second : t;
+}
+
 }
@@ -9,6 +9,7 @@
 #include <optional>
 #include <ostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace smt { class Model; }
@@ -19,6 +20,7 @@ class AggregateType;
 class FloatType;
 class StructType;
 class SymbolicType;
+class TypeCopies;
 class VoidType;
 class State;
 struct StateValue;
@@ -44,10 +46,17 @@ public:
   virtual smt::expr getDummyValue() const = 0;
 
   virtual smt::expr getTypeConstraints() const = 0;
+  // Estimate of the cost of verifying a value of this type: its bit width,
+  // plus a penalty for FP and for aggregates
+  virtual smt::expr getCost() const;
   virtual smt::expr sizeVar() const;
   smt::expr operator==(const Type &rhs) const;
   smt::expr sameType(const Type &rhs) const;
   virtual void fixup(const smt::Model &m) = 0;
+  // A copy to be fixed up independently of this type, with the children taken
+  // from 'copies'. Null if the type is never fixed up (e.g., i8) and so can be
+  // shared with the copy.
+  virtual std::unique_ptr<Type> dup(TypeCopies &copies) const = 0;
 
   virtual bool isIntType() const;
   virtual bool isFloatType() const;
@@ -99,6 +108,7 @@ public:
   smt::expr getDummyValue() const override;
   smt::expr getTypeConstraints() const override;
   void fixup(const smt::Model &m) override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   std::pair<smt::expr, std::vector<smt::expr>>
     mkInput(State &s, const char *name) const override;
   void printVal(std::ostream &os, State &s, const smt::expr &e) const override;
@@ -118,10 +128,12 @@ public:
   unsigned bits() const override;
   smt::expr getDummyValue() const override;
   smt::expr getTypeConstraints() const override;
+  smt::expr getCost() const override;
   smt::expr sizeVar() const override;
   smt::expr operator==(const IntType &rhs) const;
   smt::expr sameType(const IntType &rhs) const;
   void fixup(const smt::Model &m) override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   bool isIntType() const override;
   smt::expr enforceIntType(unsigned bits = 0) const override;
   smt::expr enforceIntOrVectorType() const override;
@@ -151,10 +163,12 @@ public:
   FpType getFpType() const { return fpType; };
   smt::expr getDummyValue() const override;
   smt::expr getTypeConstraints() const override;
+  smt::expr getCost() const override;
   smt::expr sizeVar() const override;
   smt::expr operator==(const FloatType &rhs) const;
   smt::expr sameType(const FloatType &rhs) const;
   void fixup(const smt::Model &m) override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   bool isFloatType() const override;
   smt::expr enforceFloatType() const override;
   const FloatType* getAsFloatType() const override;
@@ -179,9 +193,11 @@ public:
   unsigned bits() const override;
   smt::expr getDummyValue() const override;
   smt::expr getTypeConstraints() const override;
+  smt::expr getCost() const override;
   smt::expr operator==(const PtrType &rhs) const;
   smt::expr sameType(const PtrType &rhs) const;
   void fixup(const smt::Model &m) override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   bool isPtrType() const override;
   smt::expr enforceIntOrVectorType() const override;
   smt::expr enforceIntOrPtrOrVectorType() const override;
@@ -215,6 +231,7 @@ public:
   unsigned bits() const override;
   smt::expr getDummyValue() const override;
   smt::expr getTypeConstraints() const override;
+  smt::expr getCost() const override;
   smt::expr operator==(const AggregateType &rhs) const;
   smt::expr sameType(const AggregateType &rhs) const;
   void fixup(const smt::Model &m) override;
@@ -236,6 +253,7 @@ class ArrayType final : public AggregateType {
 public:
   ArrayType(std::string &&name) : AggregateType(std::move(name)) {}
   smt::expr getTypeConstraints() const override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   void print(std::ostream &os) const override;
 };
 
@@ -248,6 +266,7 @@ public:
   smt::expr getTypeConstraints() const override;
   smt::expr enforceIntOrVectorType() const override;
   smt::expr enforceIntOrPtrOrVectorType() const override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   void print(std::ostream &os) const override;
 };
 
@@ -259,6 +278,7 @@ public:
 
   smt::expr enforceStructType() const override;
   const StructType* getAsStructType() const override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   void print(std::ostream &os) const override;
 };
 
@@ -284,9 +304,11 @@ public:
   unsigned bits() const override;
   smt::expr getDummyValue() const override;
   smt::expr getTypeConstraints() const override;
+  smt::expr getCost() const override;
   smt::expr operator==(const Type &rhs) const;
   smt::expr sameType(const Type &rhs) const;
   void fixup(const smt::Model &m) override;
+  std::unique_ptr<Type> dup(TypeCopies &copies) const override;
   bool isIntType() const override;
   bool isFloatType() const override;
   bool isPtrType() const override;
@@ -307,4 +329,16 @@ public:
   void print(std::ostream &os) const override;
 };
 
+
+// Copies of the types of a function, made on demand, so that a copy of the
+// function can be fixed up independently (see Function::dup).
+class TypeCopies {
+  // null if the type is shared
+  std::unordered_map<const Type*, std::unique_ptr<Type>> copies;
+
+public:
+  // the copy of 't', or 't' itself if it's never fixed up
+  Type& operator[](Type &t);
+};
+
 }
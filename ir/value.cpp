@@ -2,6 +2,7 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "ir/value.h"
+#include "ir/interp.h"
 #include "smt/expr.h"
 #include "util/compiler.h"
 #include "util/config.h"
@@ -10,7 +11,7 @@ using namespace smt;
 using namespace std;
 using namespace util;
 
-static unsigned gbl_fresh_id = 0;
+static thread_local unsigned gbl_fresh_id = 0;
 
 namespace IR {
 
@@ -24,12 +25,20 @@ string Value::fresh_id() {
   return to_string(++gbl_fresh_id);
 }
 
+ConcreteVal Value::eval(Interpreter &s) const {
+  throw UnsupportedEval();
+}
+
+SlicedVal Value::evalSliced(SlicedInterpreter &s) const {
+  throw UnsupportedEval();
+}
+
 expr Value::getTypeConstraints() const {
   return getType().getTypeConstraints();
 }
 
 void Value::fixupTypes(const Model &m) {
-  type.fixup(m);
+  type->fixup(m);
 }
 
 ostream& operator<<(ostream &os, const Value &val) {
@@ -55,6 +64,11 @@ StateValue UndefValue::toSMT(State &s) const {
   return { move(var), true };
 }
 
+ConcreteVal UndefValue::eval(Interpreter &s) const {
+  s.addNondet();
+  return { APInt(bits()) };
+}
+
 string UndefValue::getFreshName() {
   return "undef_" + fresh_id();
 }
@@ -68,6 +82,14 @@ StateValue PoisonValue::toSMT(State &s) const {
   return { getType().getDummyValue(), false };
 }
 
+ConcreteVal PoisonValue::eval(Interpreter &s) const {
+  return { APInt(bits()), true };
+}
+
+SlicedVal PoisonValue::evalSliced(SlicedInterpreter &s) const {
+  return { BitSlice(bits()), UINT64_MAX };
+}
+
 
 void VoidValue::print(ostream &os) const {
   UNREACHABLE();
@@ -77,6 +99,14 @@ StateValue VoidValue::toSMT(State &s) const {
   return { false, false };
 }
 
+ConcreteVal VoidValue::eval(Interpreter &s) const {
+  return { APInt(1), true };
+}
+
+SlicedVal VoidValue::evalSliced(SlicedInterpreter &s) const {
+  return { BitSlice(1), UINT64_MAX };
+}
+
 
 void Input::print(std::ostream &os) const {
   UNREACHABLE();
@@ -105,6 +135,23 @@ StateValue Input::toSMT(State &s) const {
            config::disable_poison_input ? true : type.extract(1, 1) == 0 };
 }
 
+ConcreteVal Input::eval(Interpreter &s) const {
+  // undef inputs are expanded by the interpreter
+  if (s.isPoisonInput(getName()))
+    return { APInt(bits()), true };
+  auto &v = s.getInput(getName());
+  if (v.bits() != bits())
+    throw UnsupportedEval();
+  return { APInt(v) };
+}
+
+SlicedVal Input::evalSliced(SlicedInterpreter &s) const {
+  auto &v = s.getInput(getName());
+  if (v.v.bits() != bits())
+    throw UnsupportedEval();
+  return v;
+}
+
 expr Input::getTyVar() const {
   string tyname = "ty_" + getName();
   return expr::mkVar(tyname.c_str(), 2);
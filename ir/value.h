@@ -14,27 +14,35 @@ namespace smt { class Model; }
 
 namespace IR {
 
+struct ConcreteVal;
+class Interpreter;
+struct SlicedVal;
+class SlicedInterpreter;
 class VoidValue;
 
 
 class Value {
-  Type &type;
+  Type *type;
   std::string name;
 
 protected:
   Value(Type &type, std::string &&name)
-    : type(type), name(std::move(name)) {}
+    : type(&type), name(std::move(name)) {}
 
   void setName(std::string &&str) { name = std::move(str); }
   static std::string fresh_id();
 
 public:
-  auto bits() const { return type.bits(); }
+  auto bits() const { return type->bits(); }
   auto& getName() const { return name; }
-  auto& getType() const { return type; }
+  auto& getType() const { return *type; }
 
   virtual void print(std::ostream &os) const = 0;
   virtual StateValue toSMT(State &s) const = 0;
+  // concrete counterpart of toSMT(); throws UnsupportedEval by default
+  virtual ConcreteVal eval(Interpreter &s) const;
+  // eval() on 64 inputs at once; throws UnsupportedEval by default
+  virtual SlicedVal evalSliced(SlicedInterpreter &s) const;
   virtual smt::expr getTypeConstraints() const;
   void fixupTypes(const smt::Model &m);
 
@@ -45,6 +53,8 @@ public:
   friend std::ostream& operator<<(std::ostream &os, const Value &val);
 
   virtual ~Value() {}
+
+  friend class Function;
 };
 
 
@@ -53,6 +63,7 @@ public:
   UndefValue(Type &type) : Value(type, "undef") {}
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
 
   static std::string getFreshName();
 };
@@ -63,6 +74,8 @@ public:
   PoisonValue(Type &type) : Value(type, "poison") {}
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
 };
 
 
@@ -71,6 +84,8 @@ public:
   VoidValue() : Value(Type::voidTy, "void") {}
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
 };
 
 
@@ -80,6 +95,8 @@ public:
     Value(type, std::move(name)) {}
   void print(std::ostream &os) const override;
   StateValue toSMT(State &s) const override;
+  ConcreteVal eval(Interpreter &s) const override;
+  SlicedVal evalSliced(SlicedInterpreter &s) const override;
   smt::expr getTyVar() const;
 };
 
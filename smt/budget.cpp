@@ -0,0 +1,100 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "smt/budget.h"
+#include <algorithm>
+#include <z3.h>
+
+using namespace std;
+
+static thread_local smt::TimeBudget *current_budget = nullptr;
+
+namespace smt {
+
+TimeBudget::TimeBudget(unsigned ms) : old(current_budget) {
+  current_budget = this;
+  if (ms) {
+    deadline = chrono::steady_clock::now() + chrono::milliseconds(ms);
+    has_deadline = true;
+    watchdog = thread([this]() { watch(); });
+  }
+}
+
+TimeBudget::TimeBudget(const TimeBudget *parent) : old(current_budget) {
+  current_budget = this;
+  if (parent && parent->has_deadline) {
+    deadline = parent->deadline;
+    has_deadline = true;
+  }
+  // the watchdog also waits for cancel()
+  watchdog = thread([this]() { watch(); });
+}
+
+TimeBudget::~TimeBudget() {
+  current_budget = old;
+  if (watchdog.joinable()) {
+    {
+      lock_guard<mutex> lock(mtx);
+      done = true;
+    }
+    cv.notify_one();
+    watchdog.join();
+  }
+}
+
+void TimeBudget::watch() {
+  unique_lock<mutex> lock(mtx);
+  auto stop = [&]() { return done || canceled; };
+  if (has_deadline)
+    cv.wait_until(lock, deadline, stop);
+  else
+    cv.wait(lock, stop);
+  if (done)
+    return;
+  expired_ = true;
+
+  // a query may not have entered Z3 yet, and would miss a single interrupt
+  do {
+    for (auto c : running) {
+      Z3_interrupt(c);
+    }
+  } while (!cv.wait_for(lock, chrono::milliseconds(10),
+                        [&]() { return done; }));
+}
+
+void TimeBudget::cancel() {
+  {
+    lock_guard<mutex> lock(mtx);
+    canceled = true;
+  }
+  expired_ = true;
+  cv.notify_one();
+}
+
+TimeBudget* TimeBudget::current() {
+  return current_budget;
+}
+
+TimeBudget::Scope::Scope(TimeBudget *b) : old(current_budget) {
+  current_budget = b;
+}
+
+TimeBudget::Scope::~Scope() {
+  current_budget = old;
+}
+
+TimeBudget::Running::Running(TimeBudget *b, Z3_context c) : b(b), c(c) {
+  if (b) {
+    lock_guard<mutex> lock(b->mtx);
+    b->running.push_back(c);
+  }
+}
+
+TimeBudget::Running::~Running() {
+  if (b) {
+    lock_guard<mutex> lock(b->mtx);
+    b->running.erase(find(b->running.begin(), b->running.end(), c));
+  }
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct _Z3_context *Z3_context;
+
+namespace smt {
+
+// A wall-clock time budget for a group of queries (e.g., those of a
+// transform), which may run on several threads and Z3 contexts. The -smt-to
+// timeout bounds each query; this bounds their sum.
+// Once the deadline passes, a watchdog thread interrupts the queries in
+// flight, and queries started afterwards return UNKNOWN without being
+// solved (see Solver::check()).
+// The constructing thread uses the budget until it's destroyed; other
+// threads join it with a Scope.
+class TimeBudget {
+  std::chrono::steady_clock::time_point deadline;
+  bool has_deadline = false;
+  TimeBudget *old;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<Z3_context> running;
+  bool done = false;
+  bool canceled = false;
+  std::atomic<bool> expired_ = false;
+  std::atomic<bool> cut = false;
+  std::thread watchdog;
+
+  void watch();
+
+public:
+  // 0 ms means no limit
+  TimeBudget(unsigned ms);
+  // A budget with the deadline of 'parent' (may be null) that can also be
+  // canceled by itself, e.g., for one of the threads sharing 'parent'
+  TimeBudget(const TimeBudget *parent);
+  ~TimeBudget();
+
+  // Expires a budget made from a parent now; may be called from any thread
+  void cancel();
+
+  // the deadline has passed
+  bool expired() const { return expired_; }
+  // some query was interrupted or skipped because the deadline passed
+  bool exceeded() const { return cut; }
+  void setCut() { cut = true; }
+
+  // the budget of the calling thread, or null
+  static TimeBudget* current();
+
+  // Makes 'b' (may be null) the calling thread's budget while in scope
+  class Scope {
+    TimeBudget *old;
+  public:
+    Scope(TimeBudget *b);
+    ~Scope();
+  };
+
+  // Marks a query as running on 'c' while in scope, so that the watchdog
+  // interrupts it once the deadline passes. No-op if 'b' is null.
+  class Running {
+    TimeBudget *b;
+    Z3_context c;
+  public:
+    Running(TimeBudget *b, Z3_context c);
+    ~Running();
+  };
+};
+
+}
@@ -7,18 +7,30 @@
 
 namespace smt {
 
-context ctx;
+thread_local context ctx;
 
 void context::initialize() {
   Z3_global_param_set("model.partial", "true");
   Z3_global_param_set("smt.ematching", "false");
   Z3_global_param_set("smt.mbqi.max_iterations", "1000000");
   Z3_global_param_set("timeout", get_query_timeout());
+  for (auto &[name, value] : get_solver_params()) {
+    Z3_global_param_set(name.c_str(), value.c_str());
+  }
   ctx = Z3_mk_context_rc(nullptr);
+
+  true_ast = Z3_mk_true(ctx);
+  Z3_inc_ref(ctx, true_ast);
+  false_ast = Z3_mk_false(ctx);
+  Z3_inc_ref(ctx, false_ast);
 }
 
 void context::destroy() {
+  // the ASTs die with the context
+  consts.clear();
+  true_ast = false_ast = nullptr;
   Z3_del_context(ctx);
+  ctx = nullptr;
 }
 
 }
@@ -3,20 +3,49 @@
 // Copyright (c) 2018-present The Alive2 Authors.
 // Distributed under the MIT license that can be found in the LICENSE file.
 
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
 typedef struct _Z3_context *Z3_context;
+typedef struct _Z3_ast *Z3_ast;
 
 namespace smt {
 
 class context {
-  Z3_context ctx;
+  Z3_context ctx = nullptr;
+  std::mutex translate_mutex;
+
+  // Z3 ASTs of the inline constants (see expr) used so far. Z3 only keeps the
+  // last result of an API call alive, so these hold a reference until the
+  // context goes away.
+  Z3_ast true_ast = nullptr, false_ast = nullptr;
+  std::unordered_map<uintptr_t, Z3_ast> consts;
 
 public:
+  // number of inline constants created and of those that had to be turned
+  // into Z3 ASTs
+  uint64_t num_inline = 0, num_materialized = 0;
+
   Z3_context operator()() const { return ctx; }
 
   void initialize();
   void destroy();
+
+  friend class expr;
+  friend class Result;
 };
 
-extern context ctx;
+// Z3 contexts are not thread safe, so each thread gets its own context,
+// created by an smt_initializer living in that thread (at most one per
+// thread). expr, Solver, and Model objects belong to the context of the
+// thread that created them: they must be used and destroyed in that thread
+// only.
+// To hand an expr or a Result over to another thread, the receiving thread
+// calls expr::translate() or Result::translate() with the sender's context
+// while the sender is blocked (e.g., waiting for the receiver to finish).
+// Translations out of a context are serialized, so several threads may import
+// from the same sender at once.
+extern thread_local context ctx;
 
 }
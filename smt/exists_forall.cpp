@@ -0,0 +1,592 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "smt/exists_forall.h"
+#include "smt/ctx.h"
+#include "smt/smt.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <z3.h>
+
+using namespace smt;
+using namespace std;
+
+namespace {
+
+// sorts whose model values can be plugged back into a formula
+bool simple_sort(Z3_context c, Z3_sort s) {
+  switch (Z3_get_sort_kind(c, s)) {
+  case Z3_BOOL_SORT:
+  case Z3_BV_SORT:
+  case Z3_INT_SORT:
+  case Z3_REAL_SORT:
+  case Z3_FLOATING_POINT_SORT:
+  case Z3_ROUNDING_MODE_SORT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+}
+
+namespace smt {
+
+// Pulls the universal quantifiers of a formula to the front, replacing their
+// variables with fresh constants (collected in 'us'); existential quantifiers
+// become fresh constants as well, as they are implicitly existential.
+class ExistsForAll::Prenexer {
+  Z3_context c;
+  vector<expr> &us;
+  // (formula, positive polarity, within the scope of a universal)
+  map<tuple<Z3_ast, bool, bool>, expr> cache;
+  unordered_map<Z3_ast, bool> quantified;
+  // instantiated bodies; they are used as cache keys
+  vector<expr> bodies;
+
+  bool hasQuantifier(Z3_ast root) {
+    vector<pair<Z3_ast, bool>> todo = { { root, false } };
+    while (!todo.empty()) {
+      auto [a, expanded] = todo.back();
+      if (quantified.count(a)) {
+        todo.pop_back();
+        continue;
+      }
+
+      auto kind = Z3_get_ast_kind(c, a);
+      if (kind != Z3_APP_AST) {
+        quantified.emplace(a, kind == Z3_QUANTIFIER_AST);
+        todo.pop_back();
+        continue;
+      }
+
+      auto app = Z3_to_app(c, a);
+      unsigned num_args = Z3_get_app_num_args(c, app);
+      if (!expanded) {
+        todo.back().second = true;
+        for (unsigned i = 0; i != num_args; ++i) {
+          todo.emplace_back(Z3_get_app_arg(c, app, i), false);
+        }
+        continue;
+      }
+
+      bool q = false;
+      for (unsigned i = 0; i != num_args && !q; ++i) {
+        q = quantified.at(Z3_get_app_arg(c, app, i));
+      }
+      quantified.emplace(a, q);
+      todo.pop_back();
+    }
+    return quantified.at(root);
+  }
+
+  expr instantiate(Z3_ast q, vector<expr> *vars) {
+    unsigned n = Z3_get_quantifier_num_bound(c, q);
+    vector<expr> consts;
+    vector<Z3_ast> to(n);
+    for (unsigned i = 0; i != n; ++i) {
+      auto sort = Z3_get_quantifier_bound_sort(c, q, i);
+      if (!simple_sort(c, sort)) {
+        failed = true;
+        return {};
+      }
+      auto sym = Z3_get_quantifier_bound_name(c, q, i);
+      auto name = Z3_get_symbol_kind(c, sym) == Z3_STRING_SYMBOL
+                    ? Z3_get_symbol_string(c, sym) : "q";
+      // the de Bruijn index of the last bound variable is 0
+      auto &v = consts.emplace_back(Z3_mk_fresh_const(c, name, sort));
+      to[n - 1 - i] = v();
+    }
+    if (vars)
+      vars->insert(vars->end(), consts.begin(), consts.end());
+    return Z3_substitute_vars(c, Z3_get_quantifier_body(c, q), n, to.data());
+  }
+
+public:
+  bool failed = false;
+
+  Prenexer(Z3_context c, vector<expr> &us) : c(c), us(us) {}
+
+  expr run(Z3_ast a, bool positive, bool in_forall) {
+    if (failed)
+      return {};
+    if (!hasQuantifier(a))
+      return a;
+
+    auto key = make_tuple(a, positive, in_forall);
+    if (auto I = cache.find(key); I != cache.end())
+      return I->second;
+
+    expr ret;
+    if (Z3_get_ast_kind(c, a) == Z3_QUANTIFIER_AST) {
+      if (Z3_is_lambda(c, a)) {
+        failed = true;
+        return {};
+      }
+      bool universal = Z3_is_quantifier_forall(c, a) == positive;
+      // an existential would depend on the universal's variables
+      if (!universal && in_forall) {
+        failed = true;
+        return {};
+      }
+      auto body = instantiate(a, universal ? &us : nullptr);
+      if (failed)
+        return {};
+      ret = run(body(), positive, in_forall || universal);
+      bodies.emplace_back(move(body));
+
+    } else {
+      auto app = Z3_to_app(c, a);
+      auto kind = Z3_get_decl_kind(c, Z3_get_app_decl(c, app));
+      unsigned num_args = Z3_get_app_num_args(c, app);
+      vector<expr> args;
+      for (unsigned i = 0; i != num_args; ++i) {
+        // the antecedent of an implication is in a negative position
+        bool pos = kind == Z3_OP_NOT || (kind == Z3_OP_IMPLIES && i == 0)
+                     ? !positive : positive;
+        args.emplace_back(run(Z3_get_app_arg(c, app, i), pos, in_forall));
+      }
+      if (failed)
+        return {};
+
+      vector<Z3_ast> asts;
+      for (auto &arg : args) {
+        asts.emplace_back(arg());
+      }
+
+      switch (kind) {
+      case Z3_OP_AND:
+        ret = Z3_mk_and(c, num_args, asts.data());
+        break;
+      case Z3_OP_OR:
+        ret = Z3_mk_or(c, num_args, asts.data());
+        break;
+      case Z3_OP_NOT:
+        ret = Z3_mk_not(c, asts[0]);
+        break;
+      case Z3_OP_IMPLIES:
+        ret = Z3_mk_implies(c, asts[0], asts[1]);
+        break;
+      default:
+        // e.g., a quantifier under an ite or an equality has no polarity
+        failed = true;
+        return {};
+      }
+    }
+    cache.emplace(key, ret);
+    return ret;
+  }
+};
+
+ExistsForAll::ExistsForAll(const expr &e) {
+  if (!e.isValid())
+    return;
+
+  auto c = ctx();
+  Prenexer p(c, us);
+  body = p.run(e(), true, false);
+  has_quantifiers = p.failed || !body.eq(e);
+  if (p.failed || us.empty())
+    return;
+
+  // the remaining constants are the existential variables
+  unordered_set<Z3_ast> seen;
+  for (auto &u : us) {
+    seen.emplace(u());
+  }
+
+  vector<Z3_ast> todo = { body() };
+  while (!todo.empty()) {
+    auto a = todo.back();
+    todo.pop_back();
+    if (!seen.emplace(a).second)
+      continue;
+
+    auto kind = Z3_get_ast_kind(c, a);
+    if (kind == Z3_NUMERAL_AST)
+      continue;
+    if (kind != Z3_APP_AST)
+      return;
+
+    auto app = Z3_to_app(c, a);
+    unsigned num_args = Z3_get_app_num_args(c, app);
+    if (Z3_get_decl_kind(c, Z3_get_app_decl(c, app)) == Z3_OP_UNINTERPRETED) {
+      if (num_args != 0 || !simple_sort(c, Z3_get_sort(c, a)))
+        return;
+      xs.emplace_back(a);
+    }
+    for (unsigned i = 0; i != num_args; ++i) {
+      todo.emplace_back(Z3_get_app_arg(c, app, i));
+    }
+  }
+  ok = true;
+
+  // find the terms that depend on u
+  unordered_map<Z3_ast, unsigned> u_idx;
+  for (unsigned i = 0, e = us.size(); i != e; ++i) {
+    u_idx.emplace(us[i](), i);
+  }
+  unordered_map<Z3_ast, bool> dep;
+  vector<pair<Z3_ast, bool>> todo2 = { { body(), false } };
+  vector<Z3_ast> eqs;
+  while (!todo2.empty()) {
+    auto [a, expanded] = todo2.back();
+    if (dep.count(a)) {
+      todo2.pop_back();
+      continue;
+    }
+    if (Z3_get_ast_kind(c, a) != Z3_APP_AST || u_idx.count(a)) {
+      dep.emplace(a, u_idx.count(a));
+      todo2.pop_back();
+      continue;
+    }
+
+    auto app = Z3_to_app(c, a);
+    unsigned num_args = Z3_get_app_num_args(c, app);
+    if (!expanded) {
+      todo2.back().second = true;
+      for (unsigned i = 0; i != num_args; ++i) {
+        todo2.emplace_back(Z3_get_app_arg(c, app, i), false);
+      }
+      continue;
+    }
+
+    bool d = false;
+    for (unsigned i = 0; i != num_args && !d; ++i) {
+      d = dep.at(Z3_get_app_arg(c, app, i));
+    }
+    dep.emplace(a, d);
+    todo2.pop_back();
+    if (d && Z3_get_decl_kind(c, Z3_get_app_decl(c, app)) == Z3_OP_EQ)
+      eqs.emplace_back(a);
+  }
+
+  // Solve t = rhs for a u by inverting additions, subtractions, xors,
+  // negations, shifts, extensions, concats, extracts, and ite's (under the
+  // guard of the branch taken). The solution may depend on u, which get their
+  // counterexample values; e.g., the bits of u that an extract drops.
+  solutions.resize(us.size());
+  function<void(const expr&, Z3_ast, expr&&)> solve
+    = [&](const expr &guard, Z3_ast t, expr &&rhs) {
+    if (auto I = u_idx.find(t); I != u_idx.end()) {
+      auto &sols = solutions[I->second];
+      if (sols.size() == max_solutions)
+        return;
+      vector<unsigned> deps;
+      bool on_x = false;
+      for (auto &v : rhs.vars()) {
+        if (auto J = u_idx.find(v()); J != u_idx.end())
+          deps.emplace_back(J->second);
+        else
+          on_x = true;
+      }
+      sols.push_back({ guard, move(rhs), move(deps), on_x });
+      return;
+    }
+    if (Z3_get_ast_kind(c, t) != Z3_APP_AST)
+      return;
+
+    auto app = Z3_to_app(c, t);
+    auto kind = Z3_get_decl_kind(c, Z3_get_app_decl(c, app));
+    unsigned num_args = Z3_get_app_num_args(c, app);
+    switch (kind) {
+    case Z3_OP_ITE: {
+      expr cond = Z3_get_app_arg(c, app, 0);
+      solve(guard && cond, Z3_get_app_arg(c, app, 1), expr(rhs));
+      solve(guard && !cond, Z3_get_app_arg(c, app, 2), move(rhs));
+      break;
+    }
+    case Z3_OP_BNOT:
+      solve(guard, Z3_get_app_arg(c, app, 0), ~rhs);
+      break;
+    case Z3_OP_BNEG:
+      solve(guard, Z3_get_app_arg(c, app, 0),
+            expr::mkUInt(0, rhs.bits()) - rhs);
+      break;
+    case Z3_OP_BSUB: {
+      expr a = Z3_get_app_arg(c, app, 0);
+      expr b = Z3_get_app_arg(c, app, 1);
+      solve(guard, a(), rhs + b);
+      solve(guard, b(), a - rhs);
+      break;
+    }
+    case Z3_OP_BSHL:
+    case Z3_OP_BLSHR:
+    case Z3_OP_BASHR: {
+      // the bits shifted out keep a's value
+      expr a = Z3_get_app_arg(c, app, 0);
+      expr amount = Z3_get_app_arg(c, app, 1);
+      auto ones = expr::mkInt(-1, a.bits());
+      if (kind == Z3_OP_BSHL)
+        solve(guard, a(), rhs.lshr(amount) | (a & ~ones.lshr(amount)));
+      else
+        solve(guard, a(), (rhs << amount) | (a & ~(ones << amount)));
+      break;
+    }
+    case Z3_OP_ZERO_EXT:
+    case Z3_OP_SIGN_EXT: {
+      expr a = Z3_get_app_arg(c, app, 0);
+      solve(guard, a(), rhs.extract(a.bits() - 1, 0));
+      break;
+    }
+    case Z3_OP_CONCAT: {
+      unsigned low = rhs.bits();
+      for (unsigned i = 0; i != num_args; ++i) {
+        expr a = Z3_get_app_arg(c, app, i);
+        low -= a.bits();
+        if (dep.at(a()))
+          solve(guard, a(), rhs.extract(low + a.bits() - 1, low));
+      }
+      break;
+    }
+    case Z3_OP_EXTRACT: {
+      auto decl = Z3_get_app_decl(c, app);
+      unsigned high = Z3_get_decl_int_parameter(c, decl, 0);
+      unsigned low = Z3_get_decl_int_parameter(c, decl, 1);
+      expr a = Z3_get_app_arg(c, app, 0);
+      if (high + 1 < a.bits())
+        rhs = a.extract(a.bits() - 1, high + 1).concat(rhs);
+      if (low > 0)
+        rhs = rhs.concat(a.extract(low - 1, 0));
+      solve(guard, a(), move(rhs));
+      break;
+    }
+    case Z3_OP_BADD:
+    case Z3_OP_BXOR:
+      for (unsigned i = 0; i != num_args; ++i) {
+        auto arg = Z3_get_app_arg(c, app, i);
+        if (!dep.at(arg))
+          continue;
+        expr r = rhs;
+        for (unsigned j = 0; j != num_args; ++j) {
+          if (j != i) {
+            expr other = Z3_get_app_arg(c, app, j);
+            r = kind == Z3_OP_BADD ? r - other : r ^ other;
+          }
+        }
+        solve(guard, arg, move(r));
+      }
+      break;
+    default:
+      break;
+    }
+  };
+
+  for (auto a : eqs) {
+    expr eq(a);
+    auto app = Z3_to_app(c, a);
+    for (unsigned i = 0; i != 2; ++i) {
+      auto lhs = Z3_get_app_arg(c, app, i);
+      auto rhs = Z3_get_app_arg(c, app, 1 - i);
+      if (dep.at(lhs))
+        solve(eq, lhs, expr(rhs));
+    }
+  }
+
+  // solutions that only depend on u just give the counterexample's value
+  for (auto &sols : solutions) {
+    stable_partition(sols.begin(), sols.end(),
+                     [](auto &sol) { return sol.on_x; });
+  }
+}
+
+Result::answer ExistsForAll::check(unsigned max_iterations, unsigned timeout,
+                                   Z3_model &m, string &reason,
+                                   unsigned &iterations) const {
+  assert(ok);
+  auto c = ctx();
+  auto start = chrono::steady_clock::now();
+  iterations = 0;
+
+  // The verifier is rebuilt for each candidate, so x's values get propagated
+  // and folded into !M before solving.
+  Z3_tactic tactic = Z3_mk_tactic(c, "smt");
+  Z3_tactic_inc_ref(c, tactic);
+  for (auto name : { "simplify", "propagate-values", "simplify" }) {
+    auto t = Z3_mk_tactic(c, name);
+    Z3_tactic_inc_ref(c, t);
+    auto t2 = Z3_tactic_and_then(c, t, tactic);
+    Z3_tactic_inc_ref(c, t2);
+    Z3_tactic_dec_ref(c, t);
+    Z3_tactic_dec_ref(c, tactic);
+    tactic = t2;
+  }
+
+  Z3_solver candidate = Z3_mk_solver_from_tactic(c, tactic);
+  Z3_solver_inc_ref(c, candidate);
+
+  // the whole loop shares the timeout
+  auto check = [&](Z3_solver s) {
+    if (timeout) {
+      chrono::duration<double, milli> elapsed
+        = chrono::steady_clock::now() - start;
+      if (elapsed.count() >= timeout) {
+        reason = "timeout";
+        return Z3_L_UNDEF;
+      }
+      auto params = Z3_mk_params(c);
+      Z3_params_inc_ref(c, params);
+      Z3_params_set_uint(c, params, Z3_mk_string_symbol(c, "timeout"),
+                         timeout - (unsigned)elapsed.count());
+      Z3_solver_set_params(c, s, params);
+      Z3_params_dec_ref(c, params);
+    }
+    auto r = Z3_solver_check(c, s);
+    if (r == Z3_L_UNDEF)
+      reason = Z3_solver_get_reason_unknown(c, s);
+    return r;
+  };
+
+  auto eval = [&](Z3_model m, const expr &var) {
+    Z3_ast val = nullptr;
+    Z3_model_eval(c, m, var(), true, &val);
+    return expr(val);
+  };
+
+  Result::answer ret = Result::UNKNOWN;
+  while (true) {
+    if (iterations == max_iterations) {
+      reason = "max iterations";
+      break;
+    }
+    ++iterations;
+
+    auto r = check(candidate);
+    if (r != Z3_L_TRUE) {
+      if (r == Z3_L_FALSE)
+        ret = Result::UNSAT;
+      break;
+    }
+    auto cm = Z3_solver_get_model(c, candidate);
+    Z3_model_inc_ref(c, cm);
+
+    vector<expr> x_vals;
+    vector<Z3_ast> x_asts, x_val_asts;
+    for (auto &x : xs) {
+      x_vals.emplace_back(eval(cm, x));
+      x_asts.emplace_back(x());
+      x_val_asts.emplace_back(x_vals.back()());
+    }
+    // a formula over u, with x replaced by the candidate's values
+    auto fix_x = [&](const expr &e) {
+      return expr(Z3_substitute(c, e(), xs.size(), x_asts.data(),
+                                x_val_asts.data()));
+    };
+
+    auto verifier = Z3_mk_solver_from_tactic(c, tactic);
+    Z3_solver_inc_ref(c, verifier);
+    Z3_solver_assert(c, verifier, fix_x(!body)());
+    r = check(verifier);
+
+    if (r == Z3_L_FALSE) {
+      Z3_solver_dec_ref(c, verifier);
+      m = cm;
+      ret = Result::SAT;
+      break;
+    }
+    if (r == Z3_L_UNDEF) {
+      Z3_solver_dec_ref(c, verifier);
+      Z3_model_dec_ref(c, cm);
+      break;
+    }
+
+    // Block the candidate by instantiating M with the counterexample. A
+    // concrete value only excludes this candidate, so u is also instantiated
+    // with a term over x that evaluates to the same value: a solution of an
+    // equality that holds, a variable with that value, or else (bit-vectors
+    // only) a variable plus a constant offset.
+    auto vm = Z3_solver_get_model(c, verifier);
+    Z3_model_inc_ref(c, vm);
+    vector<expr> vals;
+    vector<Z3_ast> u_asts, val_asts;
+    for (auto &u : us) {
+      vals.emplace_back(eval(vm, u));
+      u_asts.emplace_back(u());
+      val_asts.emplace_back(vals.back()());
+    }
+
+    // A solution pins the other u it depends on to their values, and can't
+    // depend on a u that was solved already.
+    vector<expr> matched, offset;
+    vector<bool> solved(us.size()), pinned(us.size());
+    for (unsigned i = 0, e = us.size(); i != e; ++i) {
+      auto &u = us[i];
+      auto &val = vals[i];
+      auto &match = matched.emplace_back(val);
+      auto &off = offset.emplace_back(val);
+      if (pinned[i])
+        continue;
+
+      for (auto &sol : solutions[i]) {
+        if (any_of(sol.deps.begin(), sol.deps.end(),
+                   [&](unsigned d) { return solved[d]; }) ||
+            !eval(vm, fix_x(sol.guard)).isTrue())
+          continue;
+        match = Z3_substitute(c, sol.term(), us.size(), u_asts.data(),
+                              val_asts.data());
+        off = match;
+        solved[i] = true;
+        for (auto d : sol.deps) {
+          if (d != i)
+            pinned[d] = true;
+        }
+        break;
+      }
+      if (solved[i])
+        continue;
+
+      auto sort = u.sort();
+      bool has_base = Z3_get_sort_kind(c, sort) != Z3_BV_SORT;
+      for (unsigned j = 0, e = xs.size(); j != e; ++j) {
+        auto &x = xs[j];
+        auto &x_val = x_vals[j];
+        if (!Z3_is_eq_sort(c, x.sort(), sort))
+          continue;
+        if (x_val.eq(val)) {
+          match = x;
+          off = x;
+          break;
+        }
+        if (!has_base) {
+          has_base = true;
+          off = x + (val - x_val);
+        }
+      }
+    }
+    Z3_model_dec_ref(c, vm);
+    Z3_model_dec_ref(c, cm);
+    Z3_solver_dec_ref(c, verifier);
+
+    auto same = [](const vector<expr> &a, const vector<expr> &b) {
+      return equal(a.begin(), a.end(), b.begin(),
+                   [](auto &a, auto &b) { return a.eq(b); });
+    };
+    auto instantiate = [&](const vector<expr> &to) {
+      vector<Z3_ast> to_asts;
+      for (auto &t : to) {
+        to_asts.emplace_back(t());
+      }
+      expr inst = Z3_substitute(c, body(), us.size(), u_asts.data(),
+                                to_asts.data());
+      Z3_solver_assert(c, candidate, inst());
+    };
+    instantiate(vals);
+    if (!same(matched, vals))
+      instantiate(matched);
+    if (!same(offset, matched))
+      instantiate(offset);
+  }
+
+  Z3_solver_dec_ref(c, candidate);
+  Z3_tactic_dec_ref(c, tactic);
+  return ret;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "smt/expr.h"
+#include "smt/solver.h"
+#include <string>
+#include <vector>
+
+typedef struct _Z3_model* Z3_model;
+
+namespace smt {
+
+// Solves formulas of the shape  exists x. forall u. M(x, u)  with a
+// counterexample-guided loop on two quantifier-free solvers, instead of
+// Z3's model-based quantifier instantiation (MBQI):
+//  - the candidate solver looks for an x that satisfies M(x, u_i) for the
+//    counterexamples u_1..u_n found so far;
+//  - the verifier looks for a u such that !M(x, u) for that x. If there is
+//    none, x is a model; otherwise u becomes the next counterexample.
+//
+// Counterexamples are generalized before they are added to the candidate
+// solver: a universal variable is replaced with a term over x that has the
+// counterexample's value for the current candidate, when such a term can be
+// found by solving an equality of M for it, or else is a variable of x.
+//
+// Universal quantifiers in positive positions (i.e., under and, or, and the
+// right-hand side of implications) are pulled out to the front, and
+// existential ones that aren't within the scope of a universal are replaced
+// with fresh variables. Formulas with other quantifiers, lambdas,
+// uninterpreted functions, or variables of sorts without simple model values
+// (e.g., arrays) are not supported.
+class ExistsForAll {
+  class Prenexer;
+
+  expr body; // M(x, u)
+  std::vector<expr> xs, us;
+  // a term that u equals when the guard (an equality of M, plus the
+  // conditions of the ite's it went through) holds; the term may depend on
+  // u (by index) and on x
+  struct Solution {
+    expr guard, term;
+    std::vector<unsigned> deps;
+    bool on_x;
+  };
+  static constexpr unsigned max_solutions = 32;
+  std::vector<std::vector<Solution>> solutions;
+  bool has_quantifiers = false;
+  bool ok = false;
+
+public:
+  ExistsForAll(const expr &e);
+
+  // false if 'e' has no quantifiers or has an unsupported shape; the formula
+  // must then be solved as usual
+  bool supported() const { return ok; }
+  bool quantified() const { return has_quantifiers; }
+
+  // On SAT, 'm' is set to a model of x with a reference for the caller.
+  // 'max_iterations' bounds the number of candidates tried and 'timeout' (in
+  // ms; 0 for none) the time of the whole loop; reaching either gives UNKNOWN.
+  Result::answer check(unsigned max_iterations, unsigned timeout,
+                       Z3_model &m, std::string &reason,
+                       unsigned &iterations) const;
+};
+
+}
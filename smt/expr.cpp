@@ -3,11 +3,13 @@
 
 #include "smt/expr.h"
 #include "smt/ctx.h"
+#include "util/apint.h"
 #include "util/compiler.h"
 #include <algorithm>
 #include <cassert>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <z3.h>
@@ -46,6 +48,24 @@ namespace smt {
 expr::expr(Z3_ast ast) : ptr((uintptr_t)ast) {
   static_assert(sizeof(Z3_ast) == sizeof(uintptr_t));
   assert(isZ3Ast() && isValid());
+
+  // keep constants inline so that eq() remains a pointer comparison
+  if (ast == ctx.true_ast || ast == ctx.false_ast) {
+    ptr = mkInline(ast == ctx.true_ast, 0);
+    return;
+  }
+  if (Z3_get_ast_kind(ctx(), ast) == Z3_NUMERAL_AST) {
+    auto sort = Z3_get_sort(ctx(), ast);
+    if (Z3_get_sort_kind(ctx(), sort) == Z3_BV_SORT) {
+      auto bits = Z3_get_bv_sort_size(ctx(), sort);
+      uint64_t n;
+      if (bits <= inline_max_bits && Z3_get_numeral_uint64(ctx(), ast, &n)) {
+        ptr = mkInline(n, bits);
+        ++ctx.num_inline;
+        return;
+      }
+    }
+  }
   incRef();
 #if DEBUG_Z3_RC
   cout << "[Z3RC] newObj " << ast << ' ' << *this << '\n';
@@ -62,29 +82,27 @@ Z3_ast expr::ast() const {
   if (isZ3Ast())
     return (Z3_ast)ptr;
 
-  assert(0 && "TODO");
-  return 0;
+  auto bits = inlineBits();
+  if (bits == 0)
+    return inlineVal() ? ctx.true_ast : ctx.false_ast;
+
+  auto &ast = ctx.consts[ptr];
+  if (!ast) {
+    ast = Z3_mk_unsigned_int64(ctx(), inlineVal(), mkBVSort(bits));
+    Z3_inc_ref(ctx(), ast);
+    ++ctx.num_materialized;
+  }
+  return ast;
 }
 
-expr::expr(const expr &other) {
-  if (!other.isValid()) {
-    ptr = 0;
-  } else if (other.isZ3Ast()) {
-    ptr = other.ptr;
+expr::expr(const expr &other) : ptr(other.ptr) {
+  if (isValid() && isZ3Ast())
     incRef();
-  } else {
-    assert(0 && "TODO");
-  }
 }
 
 expr::~expr() {
-  if (isValid()) {
-    if (isZ3Ast()) {
-      decRef();
-    } else {
-      assert(0 && "TODO");
-    }
-  }
+  if (isValid() && isZ3Ast())
+    decRef();
 }
 
 void expr::incRef() {
@@ -111,17 +129,16 @@ void expr::operator=(expr &&other) {
 
 void expr::operator=(const expr &other) {
   ~expr();
-  if (!other.isValid()) {
-    ptr = 0;
-  } else if (other.isZ3Ast()) {
-    ptr = other.ptr;
+  ptr = other.ptr;
+  if (isValid() && isZ3Ast())
     incRef();
-  } else {
-    assert(0 && "TODO");
-  }
 }
 
 Z3_sort expr::sort() const {
+  if (!isZ3Ast()) {
+    auto bits = inlineBits();
+    return bits ? mkBVSort(bits) : Z3_mk_bool_sort(ctx());
+  }
   return Z3_get_sort(ctx(), ast());
 }
 
@@ -133,6 +150,8 @@ Z3_decl expr::decl() const {
 
 Z3_app expr::isApp() const {
   C();
+  if (!isZ3Ast())
+    return nullptr;
   auto z3_ast = ast();
   if (Z3_is_app(ctx(), z3_ast))
     return Z3_to_app(ctx(), z3_ast);
@@ -147,20 +166,20 @@ Z3_app expr::isAppOf(int app_type) const {
   return Z3_get_decl_kind(ctx(), decl) == app_type ? app : nullptr;
 }
 
-Z3_ast expr::mkTrue() {
-  return Z3_mk_true(ctx());
-}
-
-Z3_ast expr::mkFalse() {
-  return Z3_mk_false(ctx());
-}
-
 expr expr::mkUInt(uint64_t n, Z3_sort sort) {
   return Z3_mk_unsigned_int64(ctx(), n, sort);
 }
 
 expr expr::mkUInt(uint64_t n, unsigned bits) {
-  return bits ? mkUInt(n, mkBVSort(bits)) : expr();
+  if (bits == 0)
+    return {};
+  if (bits > inline_max_bits)
+    return mkUInt(n, mkBVSort(bits));
+
+  expr e;
+  e.ptr = mkInline(n & (UINT64_MAX >> (64 - bits)), bits);
+  ++ctx.num_inline;
+  return e;
 }
 
 expr expr::mkInt(int64_t n, Z3_sort sort) {
@@ -168,13 +187,49 @@ expr expr::mkInt(int64_t n, Z3_sort sort) {
 }
 
 expr expr::mkInt(int64_t n, unsigned bits) {
-  return bits ? mkInt(n, mkBVSort(bits)) : expr();
+  if (bits > inline_max_bits)
+    return mkInt(n, mkBVSort(bits));
+  return mkUInt(n, bits);
 }
 
 expr expr::mkInt(const char *n, unsigned bits) {
   return bits ? Z3_mk_numeral(ctx(), n, mkBVSort(bits)) : expr();
 }
 
+optional<APInt> expr::getAPInt() const {
+  C();
+  if (!isZ3Ast()) {
+    if (auto bw = inlineBits())
+      return APInt(bw, inlineVal());
+    return {};
+  }
+
+  auto z3_ast = ast();
+  if (!Z3_is_numeral_ast(ctx(), z3_ast))
+    return {};
+  auto sort = Z3_get_sort(ctx(), z3_ast);
+  if (Z3_get_sort_kind(ctx(), sort) != Z3_BV_SORT)
+    return {};
+
+  auto bw = Z3_get_bv_sort_size(ctx(), sort);
+  uint64_t n;
+  if (Z3_get_numeral_uint64(ctx(), z3_ast, &n))
+    return APInt(bw, n);
+  return APInt::fromBinary(bw, Z3_get_numeral_binary_string(ctx(), z3_ast));
+}
+
+expr expr::mkAPInt(const APInt &n) {
+  auto bw = n.bits();
+  if (bw <= 64)
+    return mkUInt(n.lowWord(), bw);
+
+  unique_ptr<bool[]> bits(new bool[bw]);
+  for (unsigned i = 0; i != bw; ++i) {
+    bits[i] = n.bit(i);
+  }
+  return Z3_mk_bv_numeral(ctx(), bw, bits.get());
+}
+
 expr expr::mkHalf(float n) {
   return Z3_mk_fpa_numeral_float(ctx(), n, Z3_mk_fpa_sort_half(ctx()));
 }
@@ -228,7 +283,7 @@ expr expr::IntSMax(unsigned bits) {
   assert(bits > 0);
   static_assert(sizeof(unsigned long long) == 8);
   if (bits <= 64)
-    return mkUInt(numeric_limits<uint64_t>::max() >> (65u - bits), bits);
+    return mkUInt((1ull << (bits - 1)) - 1, bits);
   return mkUInt(0, 1).concat(mkInt(-1, bits-1));
 }
 
@@ -238,22 +293,24 @@ expr expr::IntUMax(unsigned bits) {
 
 bool expr::eq(const expr &rhs) const {
   C(rhs);
-  return ast() == rhs();
+  return ptr == rhs.ptr;
 }
 
 bool expr::isConst() const {
   C();
+  if (!isZ3Ast())
+    return true;
   return Z3_is_numeral_ast(ctx(), ast());
 }
 
 bool expr::isTrue() const {
   C();
-  return Z3_get_bool_value(ctx(), ast()) == Z3_L_TRUE;
+  return ptr == mkInline(true, 0);
 }
 
 bool expr::isFalse() const {
   C();
-  return Z3_get_bool_value(ctx(), ast()) == Z3_L_FALSE;
+  return ptr == mkInline(false, 0);
 }
 
 bool expr::isZero() const {
@@ -289,16 +346,30 @@ bool expr::isSigned() const {
 
 unsigned expr::bits() const {
   C();
+  if (!isZ3Ast())
+    return inlineBits();
   return Z3_get_bv_sort_size(ctx(), sort());
 }
 
 bool expr::isUInt(uint64_t &n) const {
   C();
+  if (!isZ3Ast()) {
+    n = inlineVal();
+    return inlineBits() != 0;
+  }
   return Z3_get_numeral_uint64(ctx(), ast(), &n);
 }
 
 bool expr::isInt(int64_t &n) const {
   C();
+  if (!isZ3Ast()) {
+    // booleans have width 0, and shifting by 64 is undefined
+    auto bw = inlineBits();
+    if (bw == 0)
+      return false;
+    n = (int64_t)(inlineVal() << (64 - bw)) >> (64 - bw);
+    return true;
+  }
   auto bw = bits();
   if (bw > 64 || !Z3_get_numeral_int64(ctx(), ast(), &n))
     return false;
@@ -344,18 +415,21 @@ unsigned expr::min_leading_zeros() const {
     return a.min_leading_zeros();
   } else if (isUInt(n)) {
     return num_leading_zeros(n) - (64 - bits());
+  } else if (auto wide = getAPInt()) {
+    return wide->countLeadingZeros();
   }
   return 0;
 }
 
 expr expr::binop_commutative(const expr &rhs,
                              uint64_t (*native)(uint64_t, uint64_t),
+                             wide_binop wide,
                              Z3_ast (*z3)(Z3_context, Z3_ast, Z3_ast),
                              bool (expr::*identity)() const,
                              bool (expr::*absorvent)() const) const {
   C(rhs);
   expr r;
-  if (binop_ufold(rhs, native, r))
+  if (binop_ufold(rhs, native, wide, r))
     return r;
 
   if ((this->*absorvent)() || (rhs.*identity)())
@@ -375,38 +449,60 @@ expr expr::binop_commutative(const expr &rhs,
 }
 
 bool expr::binop_sfold(const expr &rhs,
-                       int64_t(*native)(int64_t, int64_t), expr &result) const {
+                       int64_t(*native)(int64_t, int64_t), wide_binop wide,
+                       expr &result) const {
   int64_t a, b;
   if (/*bits() <= 64 &&*/ isInt(a) && rhs.isInt(b)) {
-    result = mkInt(native(a, b), sort());
+    result = mkInt(native(a, b), bits());
     return true;
   }
-  return false;
+  return binop_wfold(rhs, wide, result);
 }
 
 bool expr::binop_ufold(const expr &rhs,
-                       uint64_t(*native)(uint64_t, uint64_t),
+                       uint64_t(*native)(uint64_t, uint64_t), wide_binop wide,
                        expr &result) const {
   uint64_t a, b;
   if (bits() <= 64 && isUInt(a) && rhs.isUInt(b)) {
-    result = mkUInt(native(a, b), sort());
+    result = mkUInt(native(a, b), bits());
     return true;
   }
-  return false;
+  return binop_wfold(rhs, wide, result);
+}
+
+// constants wider than 64 bits
+bool expr::binop_wfold(const expr &rhs, wide_binop wide, expr &result) const {
+  if (bits() <= 64)
+    return false;
+
+  auto a = getAPInt();
+  if (!a)
+    return false;
+  auto b = rhs.getAPInt();
+  if (!b)
+    return false;
+
+  result = mkAPInt(wide(*a, *b));
+  return true;
 }
 
 #define binopc(native_op, z3, identity, absorvent)                             \
   binop_commutative(rhs, [](uint64_t a, uint64_t b) { return a native_op b; }, \
+                    [](const APInt &a, const APInt &b) {                       \
+                      return a native_op b;                                    \
+                    },                                                         \
                     z3, &expr::identity, &expr::absorvent)
 
+#define wideop(op) [](const APInt &a, const APInt &b) { return a.op(b); }
+
 expr expr::operator+(const expr &rhs) const {
   return binopc(+, Z3_mk_bvadd, isZero, alwaysFalse);
 }
 
 expr expr::operator-(const expr &rhs) const {
   if (eq(rhs))
-    return mkUInt(0, sort());
-  return *this + mkInt(-1, sort()) * rhs;
+    return mkUInt(0, bits());
+  return *this + mkInt(-1, bits()) * rhs;
 }
 
 expr expr::operator*(const expr &rhs) const {
@@ -417,16 +513,16 @@ expr expr::sdiv(const expr &rhs) const {
   C(rhs);
 
   if (eq(rhs))
-    return mkUInt(1, sort());
+    return mkUInt(1, bits());
 
   if (rhs.isZero())
     return rhs;
 
   if (isSMin() && rhs.isAllOnes())
-    return mkUInt(0, sort());
+    return mkUInt(0, bits());
 
   expr r;
-  if (binop_sfold(rhs, [](auto a, auto b) { return a / b; }, r))
+  if (binop_sfold(rhs, [](auto a, auto b) { return a / b; }, wideop(sdiv), r))
     return r;
 
   return Z3_mk_bvsdiv(ctx(), ast(), rhs());
@@ -436,13 +532,13 @@ expr expr::udiv(const expr &rhs) const {
   C(rhs);
 
   if (eq(rhs))
-    return mkUInt(1, sort());
+    return mkUInt(1, bits());
 
   if (rhs.isZero())
     return rhs;
 
   expr r;
-  if (binop_ufold(rhs, [](auto a, auto b) { return a / b; }, r))
+  if (binop_ufold(rhs, [](auto a, auto b) { return a / b; }, wideop(udiv), r))
     return r;
 
   return Z3_mk_bvudiv(ctx(), ast(), rhs());
@@ -452,13 +548,13 @@ expr expr::srem(const expr &rhs) const {
   C(rhs);
 
   if (eq(rhs) || (isSMin() && rhs.isAllOnes()))
-    return mkUInt(0, sort());
+    return mkUInt(0, bits());
 
   if (rhs.isZero())
     return rhs;
 
   expr r;
-  if (binop_sfold(rhs, [](auto a, auto b) { return a % b; }, r))
+  if (binop_sfold(rhs, [](auto a, auto b) { return a % b; }, wideop(srem), r))
     return r;
 
   return Z3_mk_bvsrem(ctx(), ast(), rhs());
@@ -468,13 +564,13 @@ expr expr::urem(const expr &rhs) const {
   C(rhs);
 
   if (eq(rhs))
-    return mkUInt(0, sort());
+    return mkUInt(0, bits());
 
   if (rhs.isZero())
     return rhs;
 
   expr r;
-  if (binop_ufold(rhs, [](auto a, auto b) { return a % b; }, r))
+  if (binop_ufold(rhs, [](auto a, auto b) { return a % b; }, wideop(urem), r))
     return r;
 
   return Z3_mk_bvurem(ctx(), ast(), rhs());
@@ -512,7 +608,7 @@ expr expr::ssub_sat(const expr &rhs) const {
 
 expr expr::usub_sat(const expr &rhs) const {
   return mkIf(rhs.uge(*this),
-              mkUInt(0, sort()),
+              mkUInt(0, bits()),
               *this - rhs);
 }
 
@@ -567,14 +663,14 @@ expr expr::operator<<(const expr &rhs) const {
     return *this;
 
   expr r;
-  if (binop_ufold(rhs, [](auto a, auto b) { return a << b; }, r))
+  if (binop_ufold(rhs, [](auto a, auto b) { return a << b; }, wideop(shl), r))
     return r;
 
   uint64_t shift;
   if (rhs.isUInt(shift)) {
     auto bw = bits();
     if (shift >= bw)
-      return mkUInt(0, sort());
+      return mkUInt(0, bits());
     return extract(bw-shift-1, 0).concat(mkUInt(0, shift));
   }
 
@@ -587,7 +683,7 @@ expr expr::ashr(const expr &rhs) const {
     return *this;
 
   expr r;
-  if (binop_sfold(rhs, [](auto a, auto b) { return a >> b; }, r))
+  if (binop_sfold(rhs, [](auto a, auto b) { return a >> b; }, wideop(ashr), r))
     return r;
 
   return Z3_mk_bvashr(ctx(), ast(), rhs());
@@ -599,14 +695,14 @@ expr expr::lshr(const expr &rhs) const {
     return *this;
 
   expr r;
-  if (binop_ufold(rhs, [](auto a, auto b) { return a >> b; }, r))
+  if (binop_ufold(rhs, [](auto a, auto b) { return a >> b; }, wideop(lshr), r))
     return r;
 
   uint64_t shift;
   if (rhs.isUInt(shift)) {
     auto bw = bits();
     if (shift >= bw)
-      return mkUInt(0, sort());
+      return mkUInt(0, bits());
     return mkUInt(0, shift).concat(extract(bw-1, shift));
   }
 
@@ -647,6 +743,9 @@ expr expr::lshr_exact(const expr &rhs) const {
 
 expr expr::bswap() const {
   C();
+  if (auto n = getAPInt())
+    return mkAPInt(n->bswap());
+
   auto nbits = bits();
   constexpr unsigned bytelen = 8;
 
@@ -661,6 +760,9 @@ expr expr::bswap() const {
 
 expr expr::bitreverse() const {
   C();
+  if (auto n = getAPInt())
+    return mkAPInt(n->bitreverse());
+
   auto nbits = bits();
 
   expr res = extract(0, 0);
@@ -674,6 +776,8 @@ expr expr::bitreverse() const {
 expr expr::cttz() const {
   C();
   auto nbits = bits();
+  if (auto n = getAPInt())
+    return mkUInt(n->countTrailingZeros(), nbits);
 
   auto cond = mkUInt(nbits, nbits);
   for (int i = nbits - 1; i >= 0; --i) {
@@ -686,6 +790,8 @@ expr expr::cttz() const {
 expr expr::ctlz() const {
   C();
   auto nbits = bits();
+  if (auto n = getAPInt())
+    return mkUInt(n->countLeadingZeros(), nbits);
 
   auto cond = mkUInt(nbits, nbits);
   for (unsigned i = 0; i < nbits; ++i) {
@@ -698,6 +804,8 @@ expr expr::ctlz() const {
 expr expr::ctpop() const {
   C();
   auto nbits = bits();
+  if (auto n = getAPInt())
+    return mkUInt(n->popcount(), nbits);
 
   auto res = mkUInt(0, nbits);
   for (unsigned i = 0; i < nbits; ++i) {
@@ -868,7 +976,7 @@ expr expr::operator|(const expr &rhs) const {
 
 expr expr::operator^(const expr &rhs) const {
   if (eq(rhs))
-    return mkUInt(0, sort());
+    return mkUInt(0, bits());
   return binopc(^, Z3_mk_bvxor, isZero, alwaysFalse);
 }
 
@@ -889,8 +997,10 @@ expr expr::operator~() const {
   C();
   int64_t n;
   if (isInt(n))
-    return mkUInt(~n, sort());
-  return mkInt(-1, sort()) - *this;
+    return mkUInt(~n, bits());
+  if (auto wide = getAPInt())
+    return mkAPInt(~*wide);
+  return mkInt(-1, bits()) - *this;
 }
 
 expr expr::operator==(const expr &rhs) const {
@@ -1010,13 +1120,17 @@ expr expr::ule(const expr &rhs) const {
   if (isUInt(a) && rhs.isUInt(b))
     return a <= b;
 
+  if (auto wa = getAPInt())
+    if (auto wb = rhs.getAPInt())
+      return wa->ule(*wb);
+
   return Z3_mk_bvule(ctx(), ast(), rhs());
 }
 
 expr expr::ult(const expr &rhs) const {
   uint64_t n;
   if (rhs.isUInt(n))
-    return n == 0 ? false : ule(mkUInt(n - 1, sort()));
+    return n == 0 ? false : ule(mkUInt(n - 1, bits()));
 
   return !rhs.ule(*this);
 }
@@ -1038,6 +1152,10 @@ expr expr::sle(const expr &rhs) const {
   if (isInt(a) && rhs.isInt(b))
     return a <= b;
 
+  if (auto wa = getAPInt())
+    if (auto wb = rhs.getAPInt())
+      return wa->sle(*wb);
+
   return Z3_mk_bvsle(ctx(), ast(), rhs());
 }
 
@@ -1055,32 +1173,32 @@ expr expr::sgt(const expr &rhs) const {
 
 expr expr::ule(uint64_t rhs) const {
   C();
-  return ule(mkUInt(rhs, sort()));
+  return ule(mkUInt(rhs, bits()));
 }
 
 expr expr::ult(uint64_t rhs) const {
   C();
-  return ult(mkUInt(rhs, sort()));
+  return ult(mkUInt(rhs, bits()));
 }
 
 expr expr::uge(uint64_t rhs) const {
   C();
-  return uge(mkUInt(rhs, sort()));
+  return uge(mkUInt(rhs, bits()));
 }
 
 expr expr::ugt(uint64_t rhs) const {
   C();
-  return ugt(mkUInt(rhs, sort()));
+  return ugt(mkUInt(rhs, bits()));
 }
 
 expr expr::operator==(uint64_t rhs) const {
   C();
-  return *this == mkUInt(rhs, sort());
+  return *this == mkUInt(rhs, bits());
 }
 
 expr expr::operator!=(uint64_t rhs) const {
   C();
-  return *this != mkUInt(rhs, sort());
+  return *this != mkUInt(rhs, bits());
 }
 
 expr expr::sext(unsigned amount) const {
@@ -1091,6 +1209,8 @@ expr expr::sext(unsigned amount) const {
   int64_t n;
   if (isInt(n))
     return mkInt(n, bits() + amount);
+  if (auto wide = getAPInt())
+    return mkAPInt(wide->sext(amount));
   return Z3_mk_sign_ext(ctx(), amount, ast());
 }
 
@@ -1101,6 +1221,8 @@ expr expr::zext(unsigned amount) const {
   uint64_t n;
   if (isUInt(n))
     return mkUInt(n, bits() + amount);
+  if (auto wide = getAPInt())
+    return mkAPInt(wide->zext(amount));
   return mkUInt(0, amount).concat(*this);
 }
 
@@ -1127,6 +1249,10 @@ expr expr::concat(const expr &rhs) const {
   if (bw <= 64 && isUInt(a) && rhs.isUInt(b))
     return mkUInt((a << rhs_bits) | b, bw);
 
+  if (auto wa = getAPInt())
+    if (auto wb = rhs.getAPInt())
+      return mkAPInt(wa->concat(*wb));
+
   return Z3_mk_concat(ctx(), ast(), rhs());
 }
 
@@ -1140,6 +1266,8 @@ expr expr::extract(unsigned high, unsigned low) const {
   uint64_t n;
   if (low < 64 && isUInt(n))
     return mkUInt(n >> low, high - low + 1);
+  if (auto wide = getAPInt())
+    return mkAPInt(wide->extract(high, low));
 
   {
     expr sub;
@@ -1265,11 +1393,16 @@ expr expr::mkLambda(const set<expr> &vars, expr &&val) {
 
 expr expr::simplify() const {
   C();
+  if (!isZ3Ast())
+    return *this;
   return Z3_simplify(ctx(), ast());
 }
 
 expr expr::subst(const vector<pair<expr, expr>> &repls) const {
   C();
+  if (!isZ3Ast())
+    return *this;
+
   unique_ptr<Z3_ast[]> from(new Z3_ast[repls.size()]);
   unique_ptr<Z3_ast[]> to(new Z3_ast[repls.size()]);
 
@@ -1285,6 +1418,8 @@ expr expr::subst(const vector<pair<expr, expr>> &repls) const {
 
 expr expr::subst(const expr &from, const expr &to) const {
   C(from, to);
+  if (!isZ3Ast())
+    return *this;
   auto f = from();
   auto t = to();
   return Z3_substitute(ctx(), ast(), 1, &f, &t);
@@ -1293,6 +1428,9 @@ expr expr::subst(const expr &from, const expr &to) const {
 set<expr> expr::vars() const {
   C();
   set<expr> result;
+  if (!isZ3Ast())
+    return result;
+
   unordered_set<Z3_ast> todo{ ast() };
   unordered_set<Z3_ast> seen = todo;
 
@@ -1340,6 +1478,16 @@ set<expr> expr::vars() const {
   return result;
 }
 
+expr expr::translate(const expr &e, context &from) {
+  if (!e.isValid())
+    return {};
+  if (from() == ctx() || !e.isZ3Ast())
+    return e;
+
+  lock_guard<mutex> lock(from.translate_mutex);
+  return Z3_translate(from(), e(), ctx());
+}
+
 void expr::printUnsigned(ostream &os) const {
   os << numeral_string();
 }
@@ -1347,7 +1495,7 @@ void expr::printUnsigned(ostream &os) const {
 void expr::printSigned(ostream &os) const {
   if (isSigned()) {
     os << '-';
-    (~*this + mkUInt(1, sort())).simplify().printUnsigned(os);
+    (~*this + mkUInt(1, bits())).simplify().printUnsigned(os);
   } else {
     printUnsigned(os);
   }
@@ -1360,6 +1508,8 @@ void expr::printHexadecimal(ostream &os) const {
 
 string expr::numeral_string() const {
   C();
+  if (!isZ3Ast() && inlineBits() != 0)
+    return to_string(inlineVal());
   return Z3_get_numeral_decimal_string(ctx(), ast(), 12);
 }
 
@@ -1369,6 +1519,9 @@ ostream& operator<<(ostream &os, const expr &e) {
 
 bool expr::operator<(const expr &rhs) const {
   C(rhs);
+  // inline constants go first
+  if (!isZ3Ast() || !rhs.isZ3Ast())
+    return rhs.isZ3Ast() ? !isZ3Ast() : (!isZ3Ast() && ptr < rhs.ptr);
   assert((id() == rhs.id()) == eq(rhs));
   return id() < rhs.id();
 }
@@ -1378,6 +1531,8 @@ unsigned expr::id() const {
 }
 
 unsigned expr::hash() const {
+  if (!isZ3Ast())
+    return ptr ^ (ptr >> 32);
   return Z3_get_ast_hash(ctx(), ast());
 }
 
@@ -4,6 +4,7 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include <cstdint>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
@@ -17,10 +18,26 @@ typedef struct _Z3_ast* Z3_ast;
 typedef struct _Z3_sort* Z3_sort;
 typedef struct _Z3_func_decl* Z3_func_decl;
 
+namespace util { class APInt; }
+
 namespace smt {
 
+class context;
+
 class expr {
+  // Either a Z3_ast (bit 0 clear) or an inline constant (bit 0 set): a
+  // bit-vector of up to inline_max_bits bits or a boolean (width 0), with the
+  // width in bits 1-7 and the value in bits 8-63. Inline constants are folded
+  // natively and only become Z3 ASTs when combined with a symbolic operand.
   uintptr_t ptr;
+  static_assert(sizeof(uintptr_t) == 8);
+
+  static constexpr unsigned inline_max_bits = 56;
+  static constexpr uintptr_t mkInline(uint64_t val, unsigned bits) {
+    return (val << 8) | (bits << 1) | 1;
+  }
+  unsigned inlineBits() const { return (ptr >> 1) & 0x7f; }
+  uint64_t inlineVal() const { return ptr >> 8; }
 
   bool isZ3Ast() const;
   Z3_ast ast() const;
@@ -32,8 +49,11 @@ class expr {
   Z3_decl decl() const;
   Z3_app isAppOf(int app_type) const;
 
+  using wide_binop = util::APInt(*)(const util::APInt&, const util::APInt&);
+
   expr binop_commutative(const expr &rhs,
                          uint64_t(*native)(uint64_t, uint64_t),
+                         wide_binop wide,
                          Z3_ast(*z3)(Z3_context, Z3_ast, Z3_ast),
                          bool (expr::*identity)() const,
                          bool (expr::*absorvent)() const) const;
@@ -41,16 +61,15 @@ class expr {
                          Z3_ast(*z3)(Z3_context, Z3_ast, Z3_ast)) const;
 
   bool binop_sfold(const expr &rhs,
-                   int64_t(*native)(int64_t, int64_t),
+                   int64_t(*native)(int64_t, int64_t), wide_binop wide,
                    expr &result) const;
   bool binop_ufold(const expr &rhs,
-                   uint64_t(*native)(uint64_t, uint64_t),
+                   uint64_t(*native)(uint64_t, uint64_t), wide_binop wide,
                    expr &result) const;
+  bool binop_wfold(const expr &rhs, wide_binop wide, expr &result) const;
 
   bool alwaysFalse() const { return false; }
 
-  static Z3_ast mkTrue();
-  static Z3_ast mkFalse();
   static expr mkUInt(uint64_t n, Z3_sort sort);
   static expr mkInt(int64_t n, Z3_sort sort);
   static expr mkConst(Z3_func_decl decl);
@@ -64,7 +83,7 @@ public:
 
   expr(Z3_ast ast);
   expr(const expr &other);
-  expr(bool val) : expr(val ? mkTrue() : mkFalse()) {}
+  expr(bool val) : ptr(mkInline(val, 0)) {}
   ~expr();
 
   void operator=(expr &&other);
@@ -73,6 +92,7 @@ public:
   static expr mkUInt(uint64_t n, unsigned bits);
   static expr mkInt(int64_t n, unsigned bits);
   static expr mkInt(const char *n, unsigned bits);
+  static expr mkAPInt(const util::APInt &n);
   static expr mkHalf(float n);
   static expr mkFloat(float n);
   static expr mkDouble(double n);
@@ -105,6 +125,8 @@ public:
   unsigned bits() const;
   bool isUInt(uint64_t &n) const;
   bool isInt(int64_t &n) const;
+  // constants of any width; bit-vector numerals only
+  std::optional<util::APInt> getAPInt() const;
 
   bool isConcat(expr &a, expr &b) const;
   bool isExtract(expr &e, unsigned &high, unsigned &low) const;
@@ -253,6 +275,10 @@ public:
 
   std::set<expr> vars() const;
 
+  // import an expr owned by another thread's context into this thread's.
+  // See smt/ctx.h for when this is safe.
+  static expr translate(const expr &e, context &from);
+
   void printUnsigned(std::ostream &os) const;
   void printSigned(std::ostream &os) const;
   void printHexadecimal(std::ostream &os) const;
@@ -274,6 +300,7 @@ public:
 
   friend class Solver;
   friend class Model;
+  friend class ExistsForAll;
 };
 
 }
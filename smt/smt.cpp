@@ -5,25 +5,40 @@
 #include "smt/ctx.h"
 #include "smt/solver.h"
 #include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
 #include <z3.h>
 
 using namespace std;
 
 namespace smt {
 
+// Z3's global params and memory management are process-wide, so contexts of
+// different threads are created and torn down one at a time, and memory is
+// only reclaimed when no other thread has a live context.
+static mutex init_mutex;
+static unsigned num_initializers = 0;
+
 smt_initializer::smt_initializer() {
+  lock_guard<mutex> lock(init_mutex);
+  ++num_initializers;
   init();
 }
 
 void smt_initializer::reset() {
+  lock_guard<mutex> lock(init_mutex);
   destroy();
-  Z3_reset_memory();
+  if (num_initializers == 1)
+    Z3_reset_memory();
   init();
 }
 
 smt_initializer::~smt_initializer() {
+  lock_guard<mutex> lock(init_mutex);
   destroy();
-  Z3_finalize_memory();
+  if (--num_initializers == 0)
+    Z3_finalize_memory();
 }
 
 void smt_initializer::init() {
@@ -36,6 +51,16 @@ void smt_initializer::destroy() {
   ctx.destroy();
 }
 
+Z3_context mk_context() {
+  lock_guard<mutex> lock(init_mutex);
+  return Z3_mk_context_rc(nullptr);
+}
+
+void del_context(Z3_context c) {
+  lock_guard<mutex> lock(init_mutex);
+  Z3_del_context(c);
+}
+
 
 static string query_timeout = "10000";
 
@@ -48,18 +73,69 @@ const char* get_query_timeout() {
 }
 
 
+static vector<pair<string, string>> solver_params;
+
+void set_solver_param(string name, string value) {
+  solver_params.emplace_back(move(name), move(value));
+}
+
+const vector<pair<string, string>>& get_solver_params() {
+  return solver_params;
+}
+
+string load_solver_config(const string &file) {
+  ifstream f(file);
+  if (!f)
+    return "Couldn't open " + file;
+
+  string line;
+  for (unsigned lineno = 1; getline(f, line); ++lineno) {
+    line = line.substr(0, line.find('#'));
+    istringstream is(line);
+    string cmd, arg, val;
+    if (!(is >> cmd))
+      continue;
+
+    auto err = [&](const char *msg) {
+      return file + ':' + to_string(lineno) + ": " + msg;
+    };
+
+    if (cmd == "tactics") {
+      if (!(is >> arg) || !solver_tactics(arg))
+        return err("unknown tactic");
+    } else if (cmd == "param") {
+      if (!(is >> arg >> val))
+        return err("expected: param <name> <value>");
+      set_solver_param(move(arg), move(val));
+    } else {
+      return err("expected 'tactics' or 'param'");
+    }
+  }
+  return "";
+}
+
+
 static uint64_t z3_memory_limit = 1ull << 30; // 1 GB
 
 void set_memory_limit(uint64_t limit) {
   z3_memory_limit = limit;
 }
 
+// Z3's allocation counter is shared by all threads; charge the calling
+// thread's job if it's the only one running
+static uint64_t memory_used() {
+  auto *account = MemoryAccount::current();
+  if (account && MemoryAccount::exclusive())
+    return account->used();
+  return Z3_get_estimated_alloc_size();
+}
+
 bool hit_memory_limit() {
-  return Z3_get_estimated_alloc_size() >= z3_memory_limit;
+  return memory_used() >= z3_memory_limit;
 }
 
 bool hit_half_memory_limit() {
-  return Z3_get_estimated_alloc_size() >= (z3_memory_limit / 2);
+  return memory_used() >= (z3_memory_limit / 2);
 }
 
 }
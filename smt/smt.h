@@ -4,6 +4,10 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include <string>
+#include <utility>
+#include <vector>
+
+typedef struct _Z3_context *Z3_context;
 
 namespace smt {
 
@@ -18,9 +22,25 @@ private:
 };
 
 
+// Extra reference-counted contexts (e.g., for portfolio jobs), created and
+// deleted one at a time with the threads' own contexts; see smt.cpp
+Z3_context mk_context();
+void del_context(Z3_context c);
+
+
 void set_query_timeout(std::string ms);
 const char* get_query_timeout();
 
+// Z3 global params applied on top of Alive's defaults to new contexts
+void set_solver_param(std::string name, std::string value);
+const std::vector<std::pair<std::string, std::string>>& get_solver_params();
+
+// Loads a config file with lines "tactics t1,t2,.." and "param name value".
+// '#' starts a comment. Returns an error message, or "" on success.
+std::string load_solver_config(const std::string &file);
+
+// The limits apply to the calling thread's MemoryAccount (see
+// smt/solver.h) if it's the only one alive, or to the whole process otherwise
 void set_memory_limit(uint64_t limit);
 bool hit_memory_limit();
 bool hit_half_memory_limit();
@@ -2,32 +2,166 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "smt/solver.h"
+#include "smt/budget.h"
 #include "smt/ctx.h"
+#include "smt/exists_forall.h"
+#include "smt/smt.h"
 #include "util/compiler.h"
 #include "util/config.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <z3.h>
 
+#if __GNUC__ < 8
+# include <experimental/filesystem>
+  namespace fs = std::experimental::filesystem;
+#else
+# include <filesystem>
+  namespace fs = std::filesystem;
+#endif
+
 using namespace smt;
 using namespace util;
 using namespace std;
 
 static bool tactic_verbose = false;
+static bool profiling = false;
+
+namespace {
+struct Stats {
+  unsigned num_queries = 0;
+  unsigned num_skips = 0;
+  unsigned num_invalid = 0;
+  unsigned num_trivial = 0;
+  unsigned num_sats = 0;
+  unsigned num_unsats = 0;
+  unsigned num_unknown = 0;
+  unsigned num_cache_hits = 0;
+  unsigned num_cache_misses = 0;
+  uint64_t num_inline = 0;
+  uint64_t num_materialized = 0;
+  // queries solved by ExistsForAll, its iterations, and quantified queries it
+  // doesn't support
+  unsigned num_cegis = 0;
+  unsigned num_cegis_unsupported = 0;
+  uint64_t cegis_iterations = 0;
+  unsigned cegis_max_iterations = 0;
+  // peak Z3 allocations of a MemoryAccount, and growth during a query (bytes)
+  uint64_t max_job_mem = 0;
+  uint64_t max_query_mem = 0;
+  // queries skipped because their job was over the memory limit
+  unsigned num_mem_skips = 0;
+  // PooledSolver checkouts that created a solver / reused one
+  unsigned num_solvers_created = 0;
+  unsigned num_solvers_reused = 0;
+  // fresh / incremental
+  double bench_total_time[2] = { 0, 0 };
+  // profiled queries by time: < 1ms, < 10ms, ..., >= 10s
+  static constexpr unsigned num_time_buckets = 6;
+  unsigned time_hist[num_time_buckets] = {};
+  double time_hist_total[num_time_buckets] = {};
+
+  void operator+=(const Stats &other) {
+    num_queries      += other.num_queries;
+    num_skips        += other.num_skips;
+    num_invalid      += other.num_invalid;
+    num_trivial      += other.num_trivial;
+    num_sats         += other.num_sats;
+    num_unsats       += other.num_unsats;
+    num_unknown      += other.num_unknown;
+    num_cache_hits   += other.num_cache_hits;
+    num_cache_misses += other.num_cache_misses;
+    num_inline       += other.num_inline;
+    num_materialized += other.num_materialized;
+    num_cegis             += other.num_cegis;
+    num_cegis_unsupported += other.num_cegis_unsupported;
+    cegis_iterations      += other.cegis_iterations;
+    cegis_max_iterations   = max(cegis_max_iterations,
+                                 other.cegis_max_iterations);
+    max_job_mem    = max(max_job_mem, other.max_job_mem);
+    max_query_mem  = max(max_query_mem, other.max_query_mem);
+    num_mem_skips += other.num_mem_skips;
+    num_solvers_created += other.num_solvers_created;
+    num_solvers_reused  += other.num_solvers_reused;
+    bench_total_time[0] += other.bench_total_time[0];
+    bench_total_time[1] += other.bench_total_time[1];
+    for (unsigned i = 0; i != num_time_buckets; ++i) {
+      time_hist[i]       += other.time_hist[i];
+      time_hist_total[i] += other.time_hist_total[i];
+    }
+  }
+
+  void addTime(double seconds) {
+    unsigned i = 0;
+    for (double limit = 0.001; i + 1 != num_time_buckets && seconds >= limit;
+         limit *= 10) {
+      ++i;
+    }
+    ++time_hist[i];
+    time_hist_total[i] += seconds;
+  }
+};
+}
+
+// Each thread counts on its own and flushes into the totals when its context
+// is destroyed (see solver_destroy).
+static thread_local Stats stats;
+static Stats total_stats;
+static mutex total_stats_mutex;
 
-static unsigned num_queries = 0;
-static unsigned num_skips = 0;
-static unsigned num_invalid = 0;
-static unsigned num_trivial = 0;
-static unsigned num_sats = 0;
-static unsigned num_unsats = 0;
-static unsigned num_unknown = 0;
+static bool incremental = false;
+static bool parallel = false;
+static unsigned cegis_iterations = 0;
+static bool bench_incremental = false;
+// fresh / incremental; per transform
+static thread_local double bench_time[2];
 
 namespace {
+using Pipeline = vector<string>;
+
+const Pipeline default_pipeline = {
+  "simplify",
+  "propagate-values",
+  "simplify",
+  "elim-uncnstr",
+  "qe-light",
+  "simplify",
+  "elim-uncnstr",
+  "qe-light",
+  "simplify",
+  "smt"
+};
+
+string pipeline_desc(const Pipeline &p) {
+  string str;
+  for (auto &t : p) {
+    if (!str.empty())
+      str += ',';
+    str += t;
+  }
+  return str;
+}
+
 class Tactic {
 protected:
   Z3_tactic t = nullptr;
@@ -72,16 +206,17 @@ class MultiTactic final : public Tactic {
   Z3_goal goal = nullptr;
 
 public:
-  MultiTactic(initializer_list<const char*> ts) : Tactic("skip") {
+  // names are kept by reference; 'ts' must outlive this object
+  MultiTactic(const Pipeline &ts) : Tactic("skip") {
     if (tactic_verbose) {
       goal = Z3_mk_goal(ctx(), true, false, false);
       Z3_goal_inc_ref(ctx(), goal);
     }
 
-    for (auto I = ts.begin(), E = ts.end(); I != E; ++I) {
-      Tactic t(*I);
+    for (auto &name : ts) {
+      Tactic t(name.c_str());
       *this = mkThen(*this, t);
-      if (tactic_verbose)
+      if (tactic_verbose || profiling)
         tactics.emplace_back(move(t));
     }
   }
@@ -141,10 +276,718 @@ public:
     if (tactic_verbose)
       Z3_goal_reset(ctx(), goal);
   }
+
+  // Re-applies the tactics one at a time to the given formulas and returns
+  // the time (in seconds) taken by each. A tactic that fails or times out
+  // leaves the goal unchanged; an interrupt stops the replay.
+  vector<pair<const char*, double>> profile(Z3_ast_vector asserts) const {
+    auto c = ctx();
+    unsigned timeout = atoi(get_query_timeout());
+    vector<pair<const char*, double>> times;
+
+    auto g = Z3_mk_goal(c, true, false, false);
+    Z3_goal_inc_ref(c, g);
+    for (unsigned i = 0, e = Z3_ast_vector_size(c, asserts); i != e; ++i) {
+      Z3_goal_assert(c, g, Z3_ast_vector_get(c, asserts, i));
+    }
+
+    Tactic skip("skip");
+    for (auto &t : tactics) {
+      Tactic to(Z3_tactic_or_else(c, Z3_tactic_try_for(c, t.t, timeout),
+                                  skip.t));
+      auto start = chrono::steady_clock::now();
+      auto r = Z3_tactic_apply(c, to.t, g);
+      chrono::duration<double> time = chrono::steady_clock::now() - start;
+      times.emplace_back(t.name, time.count());
+      // interrupted
+      if (!r)
+        break;
+      Z3_apply_result_inc_ref(c, r);
+
+      auto ng = Z3_mk_goal(c, true, false, false);
+      Z3_goal_inc_ref(c, ng);
+      for (unsigned i = 0, e = Z3_apply_result_get_num_subgoals(c, r);
+           i != e; ++i) {
+        auto sg = Z3_apply_result_get_subgoal(c, r, i);
+        for (unsigned ii = 0, ee = Z3_goal_size(c, sg); ii != ee; ++ii) {
+          Z3_goal_assert(c, ng, Z3_goal_formula(c, sg, ii));
+        }
+      }
+      Z3_apply_result_dec_ref(c, r);
+      Z3_goal_dec_ref(c, g);
+      g = ng;
+    }
+    Z3_goal_dec_ref(c, g);
+    return times;
+  }
+};
+}
+
+// the tactics used by solvers from now on; see solver_tactics()
+static Pipeline pipeline = default_pipeline;
+static thread_local optional<MultiTactic> tactic;
+static thread_local string tactic_desc;
+
+
+namespace {
+// FNV-1a; unlike std::hash it's stable across runs and builds
+uint64_t fnv1a(string_view str, uint64_t h = 0xcbf29ce484222325ull) {
+  for (unsigned char c : str) {
+    h ^= c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+// two independently seeded 64-bit hashes
+struct Digest : public pair<uint64_t, uint64_t> {
+  Digest(uint64_t a = 0xcbf29ce484222325ull, uint64_t b = 0x84222325cbf29ce4ull)
+    : pair(a, b) {}
+
+  void combine(uint64_t n) {
+    first  = (first ^ n) * 0x100000001b3ull;
+    second = (second ^ (n * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+    second ^= second >> 29;
+  }
+
+  void combine(string_view str) {
+    combine(fnv1a(str));
+  }
+
+  void combine(const Digest &d) {
+    combine(d.first);
+    combine(d.second);
+  }
+};
+
+class StructuralHash {
+  Z3_context c;
+  unordered_map<Z3_ast, Digest> cache;
+  unordered_map<Z3_sort, uint64_t> sorts;
+
+  static bool isAC(Z3_decl_kind k) {
+    switch (k) {
+    case Z3_OP_AND:
+    case Z3_OP_OR:
+    case Z3_OP_XOR:
+    case Z3_OP_BADD:
+    case Z3_OP_BMUL:
+    case Z3_OP_BAND:
+    case Z3_OP_BOR:
+    case Z3_OP_BXOR:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  void sort(Digest &d, Z3_sort s) {
+    auto [I, inserted] = sorts.try_emplace(s);
+    if (inserted)
+      I->second = fnv1a(Z3_sort_to_string(c, s));
+    d.combine(I->second);
+  }
+
+  // the operands of a nested AC operation, in any order
+  void flatten(Z3_app app, Z3_decl_kind kind, vector<Z3_ast> &args) {
+    vector<Z3_app> todo{ app };
+    do {
+      auto app = todo.back();
+      todo.pop_back();
+      for (unsigned i = 0, e = Z3_get_app_num_args(c, app); i != e; ++i) {
+        auto arg = Z3_get_app_arg(c, app, i);
+        if (Z3_get_ast_kind(c, arg) == Z3_APP_AST) {
+          auto arg_app = Z3_to_app(c, arg);
+          if (Z3_get_decl_kind(c, Z3_get_app_decl(c, arg_app)) == kind) {
+            todo.emplace_back(arg_app);
+            continue;
+          }
+        }
+        args.emplace_back(arg);
+      }
+    } while (!todo.empty());
+  }
+
+  // the children whose digests go into a's digest
+  void children(Z3_ast a, vector<Z3_ast> &args) {
+    switch (Z3_get_ast_kind(c, a)) {
+    case Z3_APP_AST: {
+      auto app  = Z3_to_app(c, a);
+      auto kind = Z3_get_decl_kind(c, Z3_get_app_decl(c, app));
+      if (isAC(kind)) {
+        flatten(app, kind, args);
+      } else {
+        for (unsigned i = 0, e = Z3_get_app_num_args(c, app); i != e; ++i) {
+          args.emplace_back(Z3_get_app_arg(c, app, i));
+        }
+      }
+      break;
+    }
+    case Z3_QUANTIFIER_AST:
+      args.emplace_back(Z3_get_quantifier_body(c, a));
+      break;
+    default:
+      break;
+    }
+  }
+
+  // the children's digests must be in the cache already
+  Digest hash(Z3_ast a, const vector<Z3_ast> &children) {
+    Digest d;
+    d.combine(Z3_get_ast_kind(c, a));
+
+    switch (Z3_get_ast_kind(c, a)) {
+    case Z3_NUMERAL_AST:
+    case Z3_APP_AST: {
+      sort(d, Z3_get_sort(c, a));
+      if (Z3_is_numeral_ast(c, a)) {
+        d.combine(Z3_ast_to_string(c, a));
+        break;
+      }
+
+      auto app  = Z3_to_app(c, a);
+      auto decl = Z3_get_app_decl(c, app);
+      auto kind = Z3_get_decl_kind(c, decl);
+      d.combine(kind);
+      if (kind == Z3_OP_UNINTERPRETED) {
+        auto sym = Z3_get_decl_name(c, decl);
+        if (Z3_get_symbol_kind(c, sym) == Z3_STRING_SYMBOL)
+          d.combine(Z3_get_symbol_string(c, sym));
+        else
+          d.combine(Z3_get_symbol_int(c, sym));
+      }
+
+      for (unsigned i = 0, e = Z3_get_decl_num_parameters(c, decl); i != e;
+           ++i) {
+        if (Z3_get_decl_parameter_kind(c, decl, i) == Z3_PARAMETER_INT)
+          d.combine(Z3_get_decl_int_parameter(c, decl, i));
+      }
+
+      vector<Digest> args;
+      for (auto arg : children) {
+        args.emplace_back(cache.at(arg));
+      }
+      if (isAC(kind) || kind == Z3_OP_EQ || kind == Z3_OP_DISTINCT)
+        std::sort(args.begin(), args.end());
+      for (auto &arg : args) {
+        d.combine(arg);
+      }
+      break;
+    }
+    case Z3_VAR_AST:
+      sort(d, Z3_get_sort(c, a));
+      d.combine(Z3_get_index_value(c, a));
+      break;
+
+    case Z3_QUANTIFIER_AST:
+      if (Z3_is_lambda(c, a))
+        d.combine(2);
+      else
+        d.combine(Z3_is_quantifier_forall(c, a));
+      for (unsigned i = 0, e = Z3_get_quantifier_num_bound(c, a); i != e;
+           ++i) {
+        sort(d, Z3_get_quantifier_bound_sort(c, a, i));
+      }
+      d.combine(cache.at(children[0]));
+      break;
+
+    default:
+      d.combine(Z3_ast_to_string(c, a));
+      break;
+    }
+    return d;
+  }
+
+public:
+  StructuralHash(Z3_context c) : c(c) {}
+
+  // iterative, as queries can be too deep for the stack
+  Digest operator()(Z3_ast root) {
+    struct Node {
+      Z3_ast a;
+      vector<Z3_ast> children;
+      bool expanded = false;
+    };
+    vector<Node> todo;
+    todo.push_back({ root });
+
+    do {
+      auto idx = todo.size() - 1;
+      auto &n = todo[idx];
+      if (cache.count(n.a)) {
+        todo.pop_back();
+        continue;
+      }
+      if (!n.expanded) {
+        n.expanded = true;
+        children(n.a, n.children);
+        // the pushes invalidate 'n'
+        for (unsigned i = 0, e = n.children.size(); i != e; ++i) {
+          auto child = todo[idx].children[i];
+          if (!cache.count(child))
+            todo.push_back({ child });
+        }
+        continue;
+      }
+      auto d = hash(n.a, n.children);
+      cache.emplace(n.a, d);
+      todo.pop_back();
+    } while (!todo.empty());
+
+    return cache.at(root);
+  }
+};
+
+
+string to_hex(uint64_t n) {
+  ostringstream os;
+  os << hex << setw(16) << setfill('0') << n;
+  return os.str();
+}
+
+// writes to a temp file first so concurrent runs never see partial files
+void write_file(const fs::path &path, const string &contents) {
+  auto tmp = path;
+  tmp += ".tmp" + to_string(random_device()());
+  {
+    ofstream f(tmp);
+    if (!(f << contents))
+      return;
+  }
+  error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec)
+    fs::remove(tmp, ec);
+}
+
+// Persistent query cache: maps a structural digest of a query's assertions
+// (see StructuralHash), combined with everything else that may change its
+// answer, to UNSAT, UNKNOWN, or SAT + model. Each entry is a file in 'dir'.
+// Only models made of bool, BV, and FP constants are stored.
+class QueryCache {
+  string dir;
+
+  static bool serialize(Z3_context c, Z3_model m, ostream &os) {
+    if (Z3_model_get_num_funcs(c, m) != 0)
+      return false;
+
+    for (unsigned i = 0, e = Z3_model_get_num_consts(c, m); i != e; ++i) {
+      auto decl = Z3_model_get_const_decl(c, m, i);
+      auto sym  = Z3_get_decl_name(c, decl);
+      auto val  = Z3_model_get_const_interp(c, m, decl);
+      if (!val || Z3_get_symbol_kind(c, sym) != Z3_STRING_SYMBOL)
+        return false;
+
+      auto sort = Z3_get_range(c, decl);
+      switch (Z3_get_sort_kind(c, sort)) {
+      case Z3_BOOL_SORT:
+        if (Z3_get_bool_value(c, val) == Z3_L_UNDEF)
+          return false;
+        os << "b " << (Z3_get_bool_value(c, val) == Z3_L_TRUE);
+        break;
+
+      case Z3_BV_SORT:
+        if (!Z3_is_numeral_ast(c, val))
+          return false;
+        os << "v " << Z3_get_bv_sort_size(c, sort) << ' '
+           << Z3_get_numeral_string(c, val);
+        break;
+
+      case Z3_FLOATING_POINT_SORT: {
+        auto bv = Z3_mk_fpa_to_ieee_bv(c, val);
+        Z3_inc_ref(c, bv);
+        auto num = Z3_simplify(c, bv);
+        Z3_inc_ref(c, num);
+        bool ok = Z3_is_numeral_ast(c, num);
+        if (ok)
+          os << "f " << Z3_fpa_get_ebits(c, sort) << ' '
+             << Z3_fpa_get_sbits(c, sort) << ' '
+             << Z3_get_numeral_string(c, num);
+        Z3_dec_ref(c, num);
+        Z3_dec_ref(c, bv);
+        if (!ok)
+          return false;
+        break;
+      }
+      default:
+        return false;
+      }
+      os << ' ' << Z3_get_symbol_string(c, sym) << '\n';
+    }
+    return true;
+  }
+
+  static Z3_model deserialize(Z3_context c, istream &is) {
+    auto m = Z3_mk_model(c);
+    Z3_model_inc_ref(c, m);
+
+    string kind;
+    while (is >> kind) {
+      Z3_sort sort;
+      Z3_ast val;
+      if (kind == "b") {
+        bool b;
+        is >> b;
+        sort = Z3_mk_bool_sort(c);
+        val = b ? Z3_mk_true(c) : Z3_mk_false(c);
+      } else if (kind == "v") {
+        unsigned bits;
+        string num;
+        is >> bits >> num;
+        sort = Z3_mk_bv_sort(c, bits);
+        val = Z3_mk_numeral(c, num.c_str(), sort);
+      } else if (kind == "f") {
+        unsigned ebits, sbits;
+        string num;
+        is >> ebits >> sbits >> num;
+        sort = Z3_mk_fpa_sort(c, ebits, sbits);
+        val = Z3_mk_fpa_to_fp_bv(c, Z3_mk_numeral(c, num.c_str(),
+                                   Z3_mk_bv_sort(c, ebits + sbits)), sort);
+      } else {
+        Z3_model_dec_ref(c, m);
+        return nullptr;
+      }
+      Z3_inc_ref(c, val);
+
+      string name;
+      is.ignore(1);
+      getline(is, name);
+      auto decl = Z3_mk_func_decl(c, Z3_mk_string_symbol(c, name.c_str()), 0,
+                                  nullptr, sort);
+      Z3_add_const_interp(c, m, decl, val);
+      Z3_dec_ref(c, val);
+    }
+    return m;
+  }
+
+public:
+  QueryCache(string &&dir) : dir(move(dir)) {
+    fs::create_directories(this->dir);
+  }
+
+  // Digest of the asserted formulas plus everything else that may change the
+  // answer. The digest is structural rather than textual: it doesn't depend
+  // on Z3's AST ids, which shift whenever a cache hit skips a solver call and
+  // thus change the operand order of commutative operations we create.
+  static string key(Z3_context c, Z3_solver s, const string &solver_desc,
+                    bool uses_tactic, unsigned cegis_iterations) {
+    StructuralHash h(c);
+    auto vect = Z3_solver_get_assertions(c, s);
+    Z3_ast_vector_inc_ref(c, vect);
+    vector<Digest> asserts;
+    for (unsigned i = 0, e = Z3_ast_vector_size(c, vect); i != e; ++i) {
+      asserts.emplace_back(h(Z3_ast_vector_get(c, vect, i)));
+    }
+    Z3_ast_vector_dec_ref(c, vect);
+    sort(asserts.begin(), asserts.end());
+
+    string config = get_query_timeout();
+    config += ';';
+    config += solver_desc;
+    config += uses_tactic ? ";tactic" : ";incremental";
+    config += parallel ? ";parallel;" : ";sequential;";
+    config += "cegis=" + to_string(cegis_iterations) + ';';
+    auto params = get_solver_params();
+    sort(params.begin(), params.end());
+    for (auto &[name, value] : params) {
+      config += name;
+      config += '=';
+      config += value;
+      config += ',';
+    }
+    config += ';';
+    config += Z3_get_full_version();
+
+    Digest d = { fnv1a(config), fnv1a(config, 0x84222325cbf29ce4ull) };
+    for (auto &a : asserts) {
+      d.combine(a);
+    }
+    return to_hex(d.first) + to_hex(d.second);
+  }
+
+  // Returns false on a miss. On a hit, 'model' is only set for SAT answers and
+  // is returned with a reference already taken.
+  bool lookup(Z3_context c, const string &key, Result::answer &a,
+              Z3_model &model) const {
+    ifstream f(fs::path(dir) / key.substr(0, 16));
+    string magic, check, answer;
+    if (!(f >> magic >> check >> answer) ||
+        magic != "alive2-cache-v1" ||
+        check != key.substr(16))
+      return false;
+
+    model = nullptr;
+    if (answer == "unsat") {
+      a = Result::UNSAT;
+    } else if (answer == "unknown") {
+      a = Result::UNKNOWN;
+    } else if (answer == "sat") {
+      a = Result::SAT;
+      model = deserialize(c, f);
+      return model != nullptr;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  void store(Z3_context c, const string &key, Result::answer a,
+             Z3_model model) const {
+    ostringstream os;
+    os << "alive2-cache-v1 " << key.substr(16) << '\n';
+    switch (a) {
+    case Result::UNSAT:   os << "unsat\n"; break;
+    case Result::UNKNOWN: os << "unknown\n"; break;
+    case Result::SAT:
+      os << "sat\n";
+      if (!serialize(c, model, os))
+        return;
+      break;
+    default:
+      return;
+    }
+
+    write_file(fs::path(dir) / key.substr(0, 16), os.str());
+  }
+};
+}
+
+static optional<QueryCache> cache;
+
+
+namespace {
+Z3_tactic mk_pipeline(Z3_context c, const Pipeline &p) {
+  auto t = Z3_mk_tactic(c, "skip");
+  Z3_tactic_inc_ref(c, t);
+  for (auto &name : p) {
+    auto t2 = Z3_tactic_and_then(c, t, Z3_mk_tactic(c, name.c_str()));
+    Z3_tactic_inc_ref(c, t2);
+    Z3_tactic_dec_ref(c, t);
+    t = t2;
+  }
+  return t;
+}
+
+// Runs a query on several tactic pipelines at once, each on its own thread
+// and Z3 context, and takes the first definitive answer. Copying between
+// contexts is only done by the calling thread while no worker is running.
+class Portfolio {
+  struct Job {
+    Z3_context c;
+    Z3_solver s;
+    Z3_model m = nullptr;
+    Z3_lbool r = Z3_L_UNDEF;
+    string reason;
+    bool done = false;
+  };
+
+public:
+  vector<Pipeline> pipelines;
+  // shared by all threads
+  vector<atomic<unsigned>> wins;
+  string desc;
+
+  Portfolio(vector<Pipeline> &&pipelines)
+    : pipelines(move(pipelines)), wins(this->pipelines.size()) {
+    for (auto &p : this->pipelines) {
+      desc += pipeline_desc(p) + ';';
+    }
+  }
+
+  // On SAT, 'm' is returned with a reference already taken.
+  Z3_lbool check(Z3_solver solver, Z3_model &m, string &reason) {
+    auto c = ctx();
+    auto *budget = TimeBudget::current();
+    vector<Job> jobs(pipelines.size());
+
+    auto asserts = Z3_solver_get_assertions(c, solver);
+    Z3_ast_vector_inc_ref(c, asserts);
+    for (unsigned i = 0, e = jobs.size(); i != e; ++i) {
+      auto &job = jobs[i];
+      job.c = mk_context();
+      // interrupted tactics raise an error; we just want Z3_L_UNDEF
+      Z3_set_error_handler(job.c, [](Z3_context, Z3_error_code) {});
+      auto t = mk_pipeline(job.c, pipelines[i]);
+      job.s = Z3_mk_solver_from_tactic(job.c, t);
+      Z3_solver_inc_ref(job.c, job.s);
+      Z3_tactic_dec_ref(job.c, t);
+
+      for (unsigned ii = 0, ee = Z3_ast_vector_size(c, asserts); ii != ee;
+           ++ii) {
+        Z3_solver_assert(job.c, job.s,
+                         Z3_translate(c, Z3_ast_vector_get(c, asserts, ii),
+                                      job.c));
+      }
+    }
+    Z3_ast_vector_dec_ref(c, asserts);
+
+    mutex mtx;
+    condition_variable cv;
+    optional<unsigned> winner;
+    unsigned finished = 0;
+
+    vector<thread> threads;
+    for (unsigned i = 0, e = jobs.size(); i != e; ++i) {
+      threads.emplace_back([&, i]() {
+        auto &job = jobs[i];
+        Z3_lbool r;
+        {
+          TimeBudget::Running running(budget, job.c);
+          r = Z3_solver_check(job.c, job.s);
+        }
+        if (r == Z3_L_TRUE) {
+          job.m = Z3_solver_get_model(job.c, job.s);
+          Z3_model_inc_ref(job.c, job.m);
+        } else if (r == Z3_L_UNDEF) {
+          job.reason = Z3_solver_get_reason_unknown(job.c, job.s);
+        }
+
+        lock_guard<mutex> lock(mtx);
+        job.r = r;
+        job.done = true;
+        ++finished;
+        if (!winner && r != Z3_L_UNDEF)
+          winner = i;
+        cv.notify_one();
+      });
+    }
+
+    {
+      unique_lock<mutex> lock(mtx);
+      cv.wait(lock, [&]() { return winner || finished == jobs.size(); });
+      // a job may not have entered Z3 yet, and would miss a single interrupt
+      while (finished != jobs.size()) {
+        for (auto &job : jobs) {
+          if (!job.done)
+            Z3_interrupt(job.c);
+        }
+        cv.wait_for(lock, chrono::milliseconds(10));
+      }
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+
+    // without a definitive answer, report the first pipeline's reason
+    auto &job = jobs[winner ? *winner : 0];
+    if (winner)
+      ++wins[*winner];
+
+    auto r = job.r;
+    reason = move(job.reason);
+    if (r == Z3_L_TRUE) {
+      m = Z3_model_translate(job.c, job.m, c);
+      Z3_model_inc_ref(c, m);
+    }
+
+    for (auto &job : jobs) {
+      if (job.m)
+        Z3_model_dec_ref(job.c, job.m);
+      Z3_solver_dec_ref(job.c, job.s);
+      del_context(job.c);
+    }
+    return r;
+  }
 };
 }
 
-static optional<MultiTactic> tactic;
+static optional<Portfolio> portfolio;
+
+
+static ofstream profile_out;
+static mutex profile_mutex;
+static string dump_dir;
+// labels of this thread's queries in the profile and dumps
+static thread_local string query_transform;
+static thread_local const char *query_kind = nullptr;
+
+static const char* result_str(const Result &r) {
+  return r.isSat() ? "sat" : r.isUnsat() ? "unsat" : "unknown";
+}
+
+// Saves the query as a standalone SMT-LIB2 file named by its hash. The
+// labels, answer, and timeout go in comments at the top.
+static void dump_query(Z3_solver s, const Result &r) {
+  // the solver's own printout includes its model converter after a check
+  auto c = ctx();
+  auto asserts = Z3_solver_get_assertions(c, s);
+  Z3_ast_vector_inc_ref(c, asserts);
+  vector<Z3_ast> fmls;
+  for (unsigned i = 0, e = Z3_ast_vector_size(c, asserts); i != e; ++i) {
+    fmls.emplace_back(Z3_ast_vector_get(c, asserts, i));
+  }
+  string query
+    = Z3_benchmark_to_smtlib_string(c, "", "", "unknown", "",
+                                    fmls.empty() ? 0 : fmls.size() - 1,
+                                    fmls.data(),
+                                    fmls.empty() ? Z3_mk_true(c)
+                                                 : fmls.back());
+  Z3_ast_vector_dec_ref(c, asserts);
+
+  auto path = fs::path(dump_dir) / (to_hex(fnv1a(query)) + ".smt2");
+  if (fs::exists(path))
+    return;
+
+  ostringstream os;
+  os << "; transform: " << query_transform
+     << "\n; kind: " << (query_kind ? query_kind : "")
+     << "\n; result: " << result_str(r)
+     << "\n; timeout: " << get_query_timeout() << '\n' << query;
+  write_file(path, os.str());
+}
+
+namespace {
+// the shape of the query's DAG
+struct QueryShape {
+  unsigned nodes = 0;
+  unsigned quantifiers = 0;
+
+  QueryShape(Z3_context c, Z3_ast_vector asserts) {
+    unordered_set<Z3_ast> seen;
+    vector<Z3_ast> todo;
+    for (unsigned i = 0, e = Z3_ast_vector_size(c, asserts); i != e; ++i) {
+      todo.emplace_back(Z3_ast_vector_get(c, asserts, i));
+    }
+
+    while (!todo.empty()) {
+      auto a = todo.back();
+      todo.pop_back();
+      if (!seen.emplace(a).second)
+        continue;
+      ++nodes;
+
+      switch (Z3_get_ast_kind(c, a)) {
+      case Z3_APP_AST: {
+        auto app = Z3_to_app(c, a);
+        for (unsigned i = 0, e = Z3_get_app_num_args(c, app); i != e; ++i) {
+          todo.emplace_back(Z3_get_app_arg(c, app, i));
+        }
+        break;
+      }
+      case Z3_QUANTIFIER_AST:
+        ++quantifiers;
+        todo.emplace_back(Z3_get_quantifier_body(c, a));
+        break;
+      default:
+        break;
+      }
+    }
+  }
+};
+
+void json_string(ostream &os, string_view str) {
+  os << '"';
+  for (unsigned char c : str) {
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (c < 0x20)
+      os << "\\u" << hex << setw(4) << setfill('0') << (unsigned)c << dec;
+    else
+      os << c;
+  }
+  os << '"';
+}
+}
 
 
 namespace smt {
@@ -200,6 +1043,16 @@ ostream& operator<<(ostream &os, const Model &m) {
 }
 
 
+Result Result::translate(const Result &r, context &from) {
+  assert(from() != ctx());
+  if (!r.isSat())
+    return r.a;
+
+  lock_guard<mutex> lock(from.translate_mutex);
+  return Z3_model_translate(from(), r.m.m, ctx());
+}
+
+
 SolverPush::SolverPush(Solver &s) : s(s) {
   Z3_solver_push(ctx(), s.s);
 }
@@ -218,13 +1071,131 @@ void solver_tactic_verbose(bool yes) {
   tactic_verbose = yes;
 }
 
-Solver::Solver() {
-  s = Z3_mk_solver_from_tactic(ctx(), tactic->t);
+void solver_use_cache(string dir) {
+  if (dir.empty())
+    cache.reset();
+  else
+    cache.emplace(move(dir));
+}
+
+static bool valid_pipeline(const Pipeline &p) {
+  if (p.empty())
+    return false;
+
+  auto c = mk_context();
+  set<string> tactics;
+  for (unsigned i = 0, e = Z3_get_num_tactics(c); i != e; ++i) {
+    tactics.emplace(Z3_get_tactic_name(c, i));
+  }
+  del_context(c);
+
+  for (auto &t : p) {
+    if (!tactics.count(t))
+      return false;
+  }
+  return true;
+}
+
+bool solver_portfolio(const string &desc) {
+  if (desc.empty()) {
+    portfolio.reset();
+    return true;
+  }
+
+  vector<Pipeline> pipelines;
+  if (desc == "default") {
+    pipelines = {
+      default_pipeline,
+      { "simplify", "propagate-values", "simplify", "elim-uncnstr", "qfbv" },
+      { "simplify", "smt" },
+    };
+  } else {
+    istringstream pipes(desc);
+    string pipe, name;
+    while (getline(pipes, pipe, ':')) {
+      istringstream names(pipe);
+      auto &p = pipelines.emplace_back();
+      while (getline(names, name, ',')) {
+        p.emplace_back(move(name));
+      }
+    }
+  }
+
+  for (auto &p : pipelines) {
+    if (!valid_pipeline(p))
+      return false;
+  }
+  portfolio.emplace(move(pipelines));
+  return true;
+}
+
+bool solver_tactics(const string &desc) {
+  if (desc.empty()) {
+    pipeline = default_pipeline;
+    return true;
+  }
+
+  Pipeline p;
+  istringstream names(desc);
+  string name;
+  while (getline(names, name, ',')) {
+    p.emplace_back(move(name));
+  }
+  if (!valid_pipeline(p))
+    return false;
+  pipeline = move(p);
+  return true;
+}
+
+void solver_incremental(bool yes) {
+  incremental = yes;
+}
+
+bool solver_profile(const string &file) {
+  profiling = false;
+  if (profile_out.is_open())
+    profile_out.close();
+  if (file.empty())
+    return true;
+
+  profile_out.open(file);
+  profiling = profile_out.is_open();
+  return profiling;
+}
+
+void solver_dump_queries(string dir) {
+  dump_dir = move(dir);
+  if (!dump_dir.empty())
+    fs::create_directories(dump_dir);
+}
+
+void solver_profile_transform(string name) {
+  query_transform = move(name);
+}
+
+void solver_cegis(unsigned max_iterations) {
+  cegis_iterations = max_iterations;
+}
+
+void solver_parallel(bool yes) {
+  parallel = yes;
+}
+
+void solver_bench_incremental(bool yes) {
+  bench_incremental = yes;
+}
+
+Solver::Solver(bool incremental)
+  : uses_tactic(!incremental), cegis_iterations(::cegis_iterations) {
+  s = incremental ? Z3_mk_solver(ctx())
+                  : Z3_mk_solver_from_tactic(ctx(), tactic->t);
   Z3_solver_inc_ref(ctx(), s);
 }
 
 Solver::~Solver() {
   Z3_solver_dec_ref(ctx(), s);
+  if (block_s)
+    Z3_solver_dec_ref(ctx(), block_s);
 }
 
 void Solver::add(const expr &e) {
@@ -237,26 +1208,77 @@ void Solver::add(const expr &e) {
   }
 }
 
+void Solver::syncBlockSolver() {
+  auto c = ctx();
+  if (!block_s) {
+    block_s = Z3_mk_simple_solver(c);
+    Z3_solver_inc_ref(c, block_s);
+
+    auto params = Z3_mk_params(c);
+    Z3_params_inc_ref(c, params);
+    Z3_params_set_bool(c, params, Z3_mk_string_symbol(c, "core.minimize"),
+                       true);
+    Z3_solver_set_params(c, block_s, params);
+    Z3_params_dec_ref(c, params);
+    block_tail = true;
+  }
+
+  auto vect = Z3_solver_get_assertions(c, s);
+  Z3_ast_vector_inc_ref(c, vect);
+  for (unsigned e = Z3_ast_vector_size(c, vect); block_synced != e;
+       ++block_synced) {
+    expr tail = Z3_mk_fresh_const(c, "block", Z3_mk_bool_sort(c));
+    expr a = Z3_ast_vector_get(c, vect, block_synced);
+    Z3_solver_assert(c, block_s, block_tail.implies(!a || tail)());
+    block_tail = move(tail);
+  }
+  Z3_ast_vector_dec_ref(c, vect);
+}
+
 void Solver::block(const Model &m, bool minimize) {
   set<expr> assignments;
   for (const auto &[var, val] : m) {
     assignments.insert(var == val);
   }
 
-  if (minimize) {
-    // simple left-to-right variable discard algorithm
-    Solver s;
-    s.add(!assertions());
+  if (minimize && !config::skip_smt) {
+    // Guard each assignment with an assumption literal and check whether
+    // they imply the assertions; the unsat core gives a subset that still
+    // does. The negated assertions are kept across calls; only the ones
+    // added since (e.g., previous blocking clauses) are asserted here.
+    syncBlockSolver();
+    auto c = ctx();
+    // the assumption literals are only needed for this call
+    Z3_solver_push(c, block_s);
+
+    vector<expr> lits;
+    unordered_map<Z3_ast, expr> lit2assignment;
+    for (auto &a : assignments) {
+      expr lit = Z3_mk_fresh_const(c, "assign", Z3_mk_bool_sort(c));
+      Z3_solver_assert(c, block_s, lit.implies(a)());
+      lit2assignment.emplace(lit(), a);
+      lits.emplace_back(move(lit));
+    }
+    lits.emplace_back(!block_tail);
 
-    for (auto I = assignments.begin(); I != assignments.end(); ) {
-      SolverPush push(s);
-      expr val = *I;
-      I = assignments.erase(I);
+    vector<Z3_ast> assumptions;
+    for (auto &l : lits) {
+      assumptions.emplace_back(l());
+    }
 
-      s.add(expr::mk_and(assignments));
-      if (!s.check().isUnsat())
-        assignments.insert(val);
+    if (Z3_solver_check_assumptions(c, block_s, assumptions.size(),
+                                    assumptions.data()) == Z3_L_FALSE) {
+      auto core = Z3_solver_get_unsat_core(c, block_s);
+      Z3_ast_vector_inc_ref(c, core);
+      assignments.clear();
+      for (unsigned i = 0, e = Z3_ast_vector_size(c, core); i != e; ++i) {
+        auto I = lit2assignment.find(Z3_ast_vector_get(c, core, i));
+        if (I != lit2assignment.end())
+          assignments.insert(I->second);
+      }
+      Z3_ast_vector_dec_ref(c, core);
     }
+    Z3_solver_pop(c, block_s, 1);
   }
 
   add(!expr::mk_and(assignments));
@@ -264,9 +1286,45 @@ void Solver::block(const Model &m, bool minimize) {
 
 void Solver::reset() {
   Z3_solver_reset(ctx(), s);
+  valid = true;
+  if (block_s) {
+    Z3_solver_dec_ref(ctx(), block_s);
+    block_s = nullptr;
+    block_synced = 0;
+  }
   tactic->reset_solver();
 }
 
+// reset solvers ready for reuse; cleared by solver_destroy() since they're
+// bound to the context and to the tactic of solver_init()
+static thread_local vector<unique_ptr<Solver>> solver_pool_free;
+static bool use_solver_pool = false;
+
+void solver_pool(bool yes) {
+  use_solver_pool = yes;
+}
+
+PooledSolver::PooledSolver() {
+  if (solver_pool_free.empty()) {
+    s = new Solver();
+    ++stats.num_solvers_created;
+  } else {
+    s = solver_pool_free.back().release();
+    solver_pool_free.pop_back();
+    s->useCEGIS(::cegis_iterations);
+    ++stats.num_solvers_reused;
+  }
+}
+
+PooledSolver::~PooledSolver() {
+  if (use_solver_pool) {
+    s->reset();
+    solver_pool_free.emplace_back(s);
+  } else {
+    delete s;
+  }
+}
+
 expr Solver::assertions() const {
   auto vect = Z3_solver_get_assertions(ctx(), s);
   Z3_ast_vector_inc_ref(ctx(), vect);
@@ -282,30 +1340,215 @@ expr Solver::assertions() const {
 
 Result Solver::check() const {
   if (config::skip_smt) {
-    ++num_skips;
+    ++stats.num_skips;
     return Result::UNKNOWN;
   }
 
   if (!valid) {
-    ++num_invalid;
+    ++stats.num_invalid;
     return Result::INVALID;
   }
 
-  ++num_queries;
+  ++stats.num_queries;
   if (print_queries)
     cout << "\nSMT query:\n" << Z3_solver_to_string(ctx(), s);
 
-  tactic->check();
+  auto r = profiling ? profile() : solve();
+  if (!dump_dir.empty())
+    dump_query(s, r);
+  return r;
+}
+
+Result Solver::profile() const {
+  auto asserts = Z3_solver_get_assertions(ctx(), s);
+  Z3_ast_vector_inc_ref(ctx(), asserts);
+  QueryShape shape(ctx(), asserts);
+  auto hits = stats.num_cache_hits;
+  int64_t mem = Z3_get_estimated_alloc_size();
+  auto start = chrono::steady_clock::now();
+
+  auto r = solve();
+
+  chrono::duration<double> time = chrono::steady_clock::now() - start;
+  int64_t mem_delta = (int64_t)Z3_get_estimated_alloc_size() - mem;
+  bool cached = stats.num_cache_hits != hits;
+  stats.addTime(time.count());
+
+  // the portfolio and incremental solvers don't use our tactic
+  vector<pair<const char*, double>> tactic_times;
+  if (!cached && !portfolio && uses_tactic)
+    tactic_times = tactic->profile(asserts);
+  Z3_ast_vector_dec_ref(ctx(), asserts);
+
+  ostringstream os;
+  os << fixed << setprecision(3) << "{\"transform\": ";
+  json_string(os, query_transform);
+  os << ", \"kind\": ";
+  json_string(os, query_kind ? query_kind : "");
+  os << ", \"result\": \"" << result_str(r)
+     << "\", \"cached\": " << (cached ? "true" : "false")
+     << ", \"time_ms\": " << time.count() * 1000
+     << ", \"mem_delta\": " << mem_delta
+     << ", \"dag_size\": " << shape.nodes
+     << ", \"quantifiers\": " << shape.quantifiers
+     << ", \"tactics\": [";
+  bool first = true;
+  for (auto &[name, time] : tactic_times) {
+    os << (first ? "" : ", ") << "[\"" << name << "\", " << time * 1000 << ']';
+    first = false;
+  }
+  os << "]}\n";
+
+  lock_guard<mutex> lock(profile_mutex);
+  profile_out << os.str() << flush;
+  return r;
+}
+
+Result Solver::solve() const {
+  string cache_key;
+  if (cache) {
+    cache_key = QueryCache::key(ctx(), s,
+                                portfolio ? portfolio->desc : tactic_desc,
+                                uses_tactic, cegis_iterations);
+    Result::answer a;
+    Z3_model m;
+    if (cache->lookup(ctx(), cache_key, a, m)) {
+      ++stats.num_cache_hits;
+      switch (a) {
+      case Result::UNSAT:
+        ++stats.num_unsats;
+        return Result::UNSAT;
+      case Result::SAT: {
+        ++stats.num_sats;
+        Result r(m);
+        Z3_model_dec_ref(ctx(), m);
+        return r;
+      }
+      default:
+        ++stats.num_unknown;
+        return Result::UNKNOWN;
+      }
+    }
+    ++stats.num_cache_misses;
+  }
+
+  auto *budget = TimeBudget::current();
+  if (budget && budget->expired()) {
+    budget->setCut();
+    ++stats.num_unknown;
+    return Result::UNKNOWN;
+  }
+  // with other jobs running the usage isn't ours alone (see MemoryAccount)
+  if (MemoryAccount::current() && MemoryAccount::exclusive() &&
+      hit_memory_limit()) {
+    ++stats.num_mem_skips;
+    ++stats.num_unknown;
+    return Result::UNKNOWN;
+  }
+  TimeBudget::Running running(budget, ctx());
+  uint64_t mem_before = Z3_get_estimated_alloc_size();
+
+  Z3_lbool r;
+  Z3_model m = nullptr;
+  string reason;
+
+  optional<ExistsForAll> ef;
+  if (cegis_iterations) {
+    ef.emplace(assertions());
+    if (!ef->supported()) {
+      stats.num_cegis_unsupported += ef->quantified();
+      ef.reset();
+    }
+  }
 
-  switch (Z3_solver_check(ctx(), s)) {
+  auto solve_z3 = [&]() {
+    tactic->check();
+    r = Z3_solver_check(ctx(), s);
+    if (r == Z3_L_TRUE) {
+      m = Z3_solver_get_model(ctx(), s);
+      Z3_model_inc_ref(ctx(), m);
+    } else if (r == Z3_L_UNDEF) {
+      reason = Z3_solver_get_reason_unknown(ctx(), s);
+    }
+  };
+
+  // the answer depends on how long CEGIS took, so it's not cached if unknown
+  bool cegis_gave_up = false;
+  if (ef) {
+    // CEGIS gets half of the time, so that Z3's own quantifier instantiation
+    // can still solve what it doesn't
+    unsigned timeout = atoi(get_query_timeout());
+    auto start = chrono::steady_clock::now();
+    unsigned iterations;
+    auto a = ef->check(cegis_iterations, timeout / 2, m, reason, iterations);
+    r = a == Result::SAT ? Z3_L_TRUE
+                         : a == Result::UNSAT ? Z3_L_FALSE : Z3_L_UNDEF;
+    ++stats.num_cegis;
+    stats.cegis_iterations += iterations;
+    stats.cegis_max_iterations = max(stats.cegis_max_iterations, iterations);
+
+    // it gave up (e.g., hit the iteration cap or its share of the time), but
+    // wasn't stopped: fall back to Z3 for the rest of the time
+    cegis_gave_up = r == Z3_L_UNDEF;
+    if (cegis_gave_up && !(budget && budget->expired()) &&
+        reason.find("interrupt") == string::npos &&
+        reason.find("memory") == string::npos) {
+      chrono::duration<double, milli> elapsed
+        = chrono::steady_clock::now() - start;
+      if (timeout && elapsed.count() >= timeout) {
+        reason = "timeout";
+      } else {
+        auto set_timeout = [&](unsigned ms) {
+          auto params = Z3_mk_params(ctx());
+          Z3_params_inc_ref(ctx(), params);
+          Z3_params_set_uint(ctx(), params,
+                             Z3_mk_string_symbol(ctx(), "timeout"), ms);
+          Z3_solver_set_params(ctx(), s, params);
+          Z3_params_dec_ref(ctx(), params);
+        };
+        if (timeout)
+          set_timeout(timeout - (unsigned)elapsed.count());
+        solve_z3();
+        if (timeout)
+          set_timeout(timeout);
+      }
+    }
+  } else if (portfolio) {
+    r = portfolio->check(s, m, reason);
+  } else {
+    solve_z3();
+  }
+
+  uint64_t mem_after = Z3_get_estimated_alloc_size();
+  if (mem_after > mem_before)
+    stats.max_query_mem = max(stats.max_query_mem, mem_after - mem_before);
+  if (auto *account = MemoryAccount::current())
+    account->used();
+
+  switch (r) {
   case Z3_L_FALSE:
-    ++num_unsats;
+    ++stats.num_unsats;
+    if (cache)
+      cache->store(ctx(), cache_key, Result::UNSAT, nullptr);
     return Result::UNSAT;
-  case Z3_L_TRUE:
-    ++num_sats;
-    return Z3_solver_get_model(ctx(), s);
+  case Z3_L_TRUE: {
+    ++stats.num_sats;
+    if (cache)
+      cache->store(ctx(), cache_key, Result::SAT, m);
+    Result res(m);
+    Z3_model_dec_ref(ctx(), m);
+    return res;
+  }
   case Z3_L_UNDEF:
-    ++num_unknown;
+    ++stats.num_unknown;
+    if (budget && budget->expired())
+      budget->setCut();
+    // only cache answers that will be the same next time
+    if (cache && !cegis_gave_up &&
+        reason.find("cancel") == string::npos &&
+        reason.find("interrupt") == string::npos &&
+        reason.find("memory") == string::npos)
+      cache->store(ctx(), cache_key, Result::UNKNOWN, nullptr);
     return Result::UNKNOWN;
   default:
     UNREACHABLE();
@@ -313,46 +1556,356 @@ Result Solver::check() const {
 }
 
 void Solver::check(initializer_list<E> queries) {
-  for (auto &[q, error] : queries) {
-    if (!q.isValid()) {
-      ++num_invalid;
-      error(Result::INVALID);
-      return;
+  check(true, queries);
+}
+
+namespace {
+struct ParallelJob {
+  context *c = nullptr; // of the worker, once the job starts
+  const Result *r = nullptr; // owned by the worker
+  bool done = false;
+  bool canceled = false;
+};
+}
+
+// Checks the queries on a pool of threads, each with its own context. Once a
+// query fails, the ones after it are canceled, since only the first failure
+// gets reported. Returns the index of the first query that isn't UNSAT, or
+// queries.size().
+static unsigned check_parallel(const vector<expr> &queries,
+                               const vector<const char*> &kinds, Result &r) {
+  auto &main_ctx = ctx;
+  string transform = query_transform;
+  auto *budget = TimeBudget::current();
+  auto *account = MemoryAccount::current();
+  unsigned n = queries.size();
+  unsigned num_threads = min(n, max(1u, thread::hardware_concurrency()));
+  vector<ParallelJob> jobs(n);
+  mutex mtx;
+  condition_variable cv;
+  unsigned next = 0, finished = 0;
+  bool release = false;
+
+  vector<thread> threads;
+  for (unsigned t = 0; t != num_threads; ++t) {
+    threads.emplace_back([&]() {
+      smt_initializer smt_init;
+      // canceled queries raise an error; we just want UNKNOWN
+      Z3_set_error_handler(ctx(), [](Z3_context, Z3_error_code) {});
+      query_transform = transform;
+      TimeBudget::Scope budget_scope(budget);
+      MemoryAccount::Scope account_scope(account);
+      // jobs are taken in order, so once one of ours is interrupted the
+      // following ones are canceled as well and a stale interrupt is harmless
+      list<Result> results;
+
+      unique_lock<mutex> lock(mtx);
+      while (next < n) {
+        unsigned i = next++;
+        auto &job = jobs[i];
+        auto &res = results.emplace_back();
+        if (!job.canceled) {
+          job.c = &ctx;
+          lock.unlock();
+          query_kind = kinds[i];
+          // the main thread waits for us, so its context is idle
+          expr q = expr::translate(queries[i], main_ctx);
+          PooledSolver s;
+          s->add(q);
+          res = s->check();
+          lock.lock();
+        }
+        job.r = &res;
+        job.done = true;
+        ++finished;
+        cv.notify_all();
+      }
+      // the main thread translates the result while we keep it alive
+      cv.wait(lock, [&]() { return release; });
+    });
+  }
+
+  unsigned failed = n;
+  {
+    unique_lock<mutex> lock(mtx);
+    while (true) {
+      for (unsigned i = 0; i < failed; ++i) {
+        if (jobs[i].done && !jobs[i].r->isUnsat()) {
+          failed = i;
+          break;
+        }
+      }
+      if (finished == n)
+        break;
+
+      bool pending = false;
+      for (unsigned i = failed + 1; i < n; ++i) {
+        auto &job = jobs[i];
+        job.canceled = true;
+        if (!job.done && job.c) {
+          Z3_interrupt((*job.c)());
+          pending = true;
+        }
+      }
+
+      // a job may not have entered Z3 yet, and would miss a single interrupt
+      if (pending)
+        cv.wait_for(lock, chrono::milliseconds(10));
+      else
+        cv.wait(lock);
+    }
+
+    if (failed < n)
+      r = Result::translate(*jobs[failed].r, *jobs[failed].c);
+    release = true;
+    cv.notify_all();
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+  return failed;
+}
+
+unsigned Solver::check(const expr &common, const vector<E> &queries,
+                       bool incremental, Result &r) {
+  optional<Solver> inc_solver;
+  // parallel mode: the non-trivial queries and their indexes
+  vector<expr> par_queries;
+  vector<const char*> par_kinds;
+  vector<unsigned> par_idxs;
+  unsigned i = 0;
+
+  for (auto I = queries.begin(), E = queries.end(); I != E; ++I, ++i) {
+    auto &q = I->query;
+    query_kind = I->kind;
+    expr full_q = common && q;
+    if (!full_q.isValid()) {
+      ++stats.num_invalid;
+      // earlier queries take precedence
+      if (!par_queries.empty()) {
+        Result r2;
+        auto failed = check_parallel(par_queries, par_kinds, r2);
+        if (failed < par_queries.size()) {
+          r = move(r2);
+          return par_idxs[failed];
+        }
+      }
+      r = Result::INVALID;
+      return i;
     }
 
-    if (q.isFalse()) {
-      ++num_trivial;
+    if (full_q.isFalse()) {
+      ++stats.num_trivial;
       continue;
     }
 
-    // TODO: benchmark: reset() or new solver every time?
-    Solver s;
-    s.add(q);
-    auto res = s.check();
-    if (!res.isUnsat()) {
-      error(res);
-      return;
+    if (parallel && !incremental) {
+      par_queries.emplace_back(move(full_q));
+      par_kinds.emplace_back(I->kind);
+      par_idxs.emplace_back(i);
+      continue;
+    }
+
+    if (incremental) {
+      if (!inc_solver) {
+        inc_solver.emplace(true);
+        inc_solver->add(common);
+      }
+      SolverPush push(*inc_solver);
+      inc_solver->add(q);
+      r = inc_solver->check();
+    } else {
+      PooledSolver s;
+      s->add(full_q);
+      r = s->check();
     }
+
+    if (!r.isUnsat())
+      return i;
+  }
+
+  if (par_queries.size() == 1) {
+    query_kind = par_kinds[0];
+    PooledSolver s;
+    s->add(par_queries[0]);
+    r = s->check();
+    if (!r.isUnsat())
+      return par_idxs[0];
+  } else if (!par_queries.empty()) {
+    auto failed = check_parallel(par_queries, par_kinds, r);
+    if (failed < par_queries.size())
+      return par_idxs[failed];
   }
+  return i;
+}
+
+void Solver::check(const expr &common, initializer_list<E> queries) {
+  check(common, vector<E>(queries));
+}
+
+void Solver::check(const expr &common, const vector<E> &queries) {
+  Result r;
+  unsigned failed = queries.size();
+
+  if (bench_incremental) {
+    // run both variants; report the result of the selected one
+    for (bool inc : { false, true }) {
+      Result r2;
+      auto start = chrono::steady_clock::now();
+      auto failed2 = check(common, queries, inc, r2);
+      chrono::duration<double> time = chrono::steady_clock::now() - start;
+      bench_time[inc] += time.count();
+      stats.bench_total_time[inc] += time.count();
+
+      if (inc == incremental) {
+        r = move(r2);
+        failed = failed2;
+      }
+    }
+  } else {
+    failed = check(common, queries, incremental, r);
+  }
+  query_kind = nullptr;
+
+  if (failed < queries.size())
+    queries[failed].report(r);
+}
+
+void solver_print_bench(ostream &os) {
+  os << fixed << setprecision(1)
+     << "SMT time: " << bench_time[0] * 1000 << " ms fresh, "
+     << bench_time[1] * 1000 << " ms incremental\n";
 }
 
 void solver_print_stats(ostream &os) {
-  float total = num_queries / 100.0;
-  float trivial_pc = num_queries == 0 ? 0 :
-                       (num_trivial * 100.0) / (num_trivial + num_queries);
-  float unknown_pc = num_queries == 0 ? 0 : num_unknown / total;
-  float sat_pc     = num_queries == 0 ? 0 : num_sats / total;
-  float unsat_pc   = num_queries == 0 ? 0 : num_unsats / total;
+  Stats all;
+  {
+    lock_guard<mutex> lock(total_stats_mutex);
+    all = total_stats;
+  }
+  all += stats;
+  all.num_inline       += ctx.num_inline;
+  all.num_materialized += ctx.num_materialized;
+
+  float total = all.num_queries / 100.0;
+  float trivial_pc = all.num_queries == 0 ? 0 :
+                       (all.num_trivial * 100.0) /
+                       (all.num_trivial + all.num_queries);
+  float unknown_pc = all.num_queries == 0 ? 0 : all.num_unknown / total;
+  float sat_pc     = all.num_queries == 0 ? 0 : all.num_sats / total;
+  float unsat_pc   = all.num_queries == 0 ? 0 : all.num_unsats / total;
 
   os << fixed << setprecision(1);
   os << "\n------------------- SMT STATS -------------------\n"
-        "Num queries: " << num_queries << "\n"
-        "Num invalid: " << num_invalid << "\n"
-        "Num skips:   " << num_skips << "\n"
-        "Num trivial: " << num_trivial << " (" << trivial_pc << "%)\n"
-        "Num unknown: " << num_unknown << " (" << unknown_pc << "%)\n"
-        "Num SAT:     " << num_sats << " (" << sat_pc << "%)\n"
-        "Num UNSAT:   " << num_unsats << " (" << unsat_pc << "%)\n";
+        "Num queries: " << all.num_queries << "\n"
+        "Num invalid: " << all.num_invalid << "\n"
+        "Num skips:   " << all.num_skips << "\n"
+        "Num trivial: " << all.num_trivial << " (" << trivial_pc << "%)\n"
+        "Num unknown: " << all.num_unknown << " (" << unknown_pc << "%)\n"
+        "Num SAT:     " << all.num_sats << " (" << sat_pc << "%)\n"
+        "Num UNSAT:   " << all.num_unsats << " (" << unsat_pc << "%)\n"
+        "Num inline:  " << all.num_inline << " (" << all.num_materialized
+                        << " sent to Z3)\n";
+
+  if (all.num_cegis || all.num_cegis_unsupported)
+    os << "CEGIS:       " << all.num_cegis << " queries, "
+       << all.cegis_iterations << " iterations (max "
+       << all.cegis_max_iterations << "), " << all.num_cegis_unsupported
+       << " unsupported\n";
+
+  if (all.max_job_mem || all.max_query_mem || all.num_mem_skips)
+    os << "Memory:      max " << all.max_job_mem / (1024 * 1024)
+       << " MB per transform, max " << all.max_query_mem / (1024 * 1024)
+       << " MB per query, " << all.num_mem_skips
+       << " queries skipped over the limit\n";
+
+  if (all.num_solvers_reused)
+    os << "Solvers:     " << all.num_solvers_created << " created, "
+       << all.num_solvers_reused << " reused\n";
+
+  if (bench_incremental)
+    os << "Time fresh:  " << all.bench_total_time[0] << " s\n"
+          "Time incr.:  " << all.bench_total_time[1] << " s\n";
+
+  if (portfolio) {
+    os << "Portfolio wins:\n";
+    for (unsigned i = 0, e = portfolio->pipelines.size(); i != e; ++i) {
+      os << "  " << portfolio->wins[i].load() << '\t'
+         << pipeline_desc(portfolio->pipelines[i]) << '\n';
+    }
+  }
+
+  if (cache) {
+    unsigned lookups = all.num_cache_hits + all.num_cache_misses;
+    float hit_pc = lookups == 0 ? 0 : (all.num_cache_hits * 100.0) / lookups;
+    os << "Cache hits:  " << all.num_cache_hits << " (" << hit_pc << "%)\n"
+          "Cache miss:  " << all.num_cache_misses << '\n';
+  }
+
+  if (profiling) {
+    static const char *labels[] = {
+      "< 1 ms", "< 10 ms", "< 100 ms", "< 1 s", "< 10 s", ">= 10 s"
+    };
+    static_assert(size(labels) == Stats::num_time_buckets);
+    double total_time = 0;
+    for (auto t : all.time_hist_total) {
+      total_time += t;
+    }
+
+    os << "Query times:\n";
+    for (unsigned i = 0; i != Stats::num_time_buckets; ++i) {
+      float pc = total_time == 0 ? 0
+                                 : all.time_hist_total[i] * 100 / total_time;
+      os << "  " << left << setw(9) << labels[i] << right
+         << all.time_hist[i] << " queries, " << all.time_hist_total[i]
+         << " s (" << pc << "%)\n";
+    }
+  }
+}
+
+
+static thread_local MemoryAccount *current_account = nullptr;
+static atomic<unsigned> num_accounts = 0;
+
+MemoryAccount::MemoryAccount()
+  : base(Z3_get_estimated_alloc_size()), old(current_account) {
+  current_account = this;
+  ++num_accounts;
+}
+
+MemoryAccount::~MemoryAccount() {
+  used();
+  --num_accounts;
+  current_account = old;
+  stats.max_job_mem = max(stats.max_job_mem, peak());
+}
+
+bool MemoryAccount::exclusive() {
+  return num_accounts == 1;
+}
+
+uint64_t MemoryAccount::used() {
+  uint64_t now = Z3_get_estimated_alloc_size();
+  uint64_t used = now > base ? now - base : 0;
+  // the peak only records growth that is ours alone
+  if (exclusive()) {
+    uint64_t peak = peak_;
+    while (used > peak && !peak_.compare_exchange_weak(peak, used));
+  }
+  return used;
+}
+
+MemoryAccount* MemoryAccount::current() {
+  return current_account;
+}
+
+MemoryAccount::Scope::Scope(MemoryAccount *a) : old(current_account) {
+  current_account = a;
+}
+
+MemoryAccount::Scope::~Scope() {
+  current_account = old;
 }
 
 
@@ -366,22 +1919,22 @@ EnableSMTQueriesTMP::~EnableSMTQueriesTMP() {
 
 
 void solver_init() {
-  tactic.emplace({
-    "simplify",
-    "propagate-values",
-    "simplify",
-    "elim-uncnstr",
-    "qe-light",
-    "simplify",
-    "elim-uncnstr",
-    "qe-light",
-    "simplify",
-    "smt"
-  });
+  tactic.emplace(pipeline);
+  tactic_desc = pipeline_desc(pipeline);
+  bench_time[0] = bench_time[1] = 0;
 }
 
 void solver_destroy() {
+  solver_pool_free.clear();
   tactic.reset();
+
+  stats.num_inline       += ctx.num_inline;
+  stats.num_materialized += ctx.num_materialized;
+  ctx.num_inline = ctx.num_materialized = 0;
+
+  lock_guard<mutex> lock(total_stats_mutex);
+  total_stats += stats;
+  stats = Stats();
 }
 
 }
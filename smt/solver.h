@@ -4,11 +4,14 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "smt/expr.h"
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <functional>
 #include <ostream>
+#include <string>
 #include <utility>
+#include <vector>
 
 typedef struct _Z3_model* Z3_model;
 typedef struct _Z3_solver* Z3_solver;
@@ -71,6 +74,9 @@ public:
     return m;
   }
 
+  // import a Result owned by another thread's context; see smt/ctx.h
+  static Result translate(const Result &r, context &from);
+
 private:
   Model m;
   answer a;
@@ -95,29 +101,151 @@ public:
 class Solver {
   Z3_solver s;
   bool valid = true;
-  using E = std::pair<expr, std::function<void(const Result &r)>>;
+  bool uses_tactic;
+  unsigned cegis_iterations;
+
+  // Used by block() to minimize models: holds the negation of the first
+  // 'block_synced' assertions of 's' as the chain of clauses
+  // !a1 \/ t1, t1 => !a2 \/ t2, ..., checked assuming !block_tail.
+  Z3_solver block_s = nullptr;
+  expr block_tail;
+  unsigned block_synced = 0;
+  void syncBlockSolver();
+
+public:
+  // a query, the callback to report its failure, and a label for the profile
+  struct E {
+    expr query;
+    std::function<void(const Result &r)> report;
+    const char *kind = nullptr;
+  };
+
+private:
+  static unsigned check(const expr &common, const std::vector<E> &queries,
+                        bool incremental, Result &r);
+  Result solve() const;
+  Result profile() const;
+
 public:
-  Solver();
+  // An incremental solver doesn't use our tactic pipeline, but keeps learned
+  // clauses and preprocessing across push/pop scopes
+  Solver(bool incremental = false);
   ~Solver();
 
   void add(const expr &e);
   void block(const Model &m, bool minimize = false);
   void reset();
+  // Solve quantified queries with the counterexample-guided engine (see
+  // smt/exists_forall.h), trying at most 'max_iterations' candidates; 0 uses
+  // Z3's MBQI. Defaults to the value given to solver_cegis().
+  void useCEGIS(unsigned max_iterations) { cegis_iterations = max_iterations; }
 
   expr assertions() const;
 
   Result check() const;
   static void check(std::initializer_list<E> queries);
+  // 'common' is conjoined with each query; in incremental mode it's asserted
+  // only once and each query is checked in its own push/pop scope
+  static void check(const expr &common, std::initializer_list<E> queries);
+  static void check(const expr &common, const std::vector<E> &queries);
 
   friend class SolverPush;
 };
 
 
+// A non-incremental solver for the lifetime of this object. If pooling is
+// enabled (see solver_pool()), it's taken from this thread's pool and reset
+// and put back on destruction; otherwise it's a fresh solver.
+class PooledSolver {
+  Solver *s;
+public:
+  PooledSolver();
+  ~PooledSolver();
+  PooledSolver(const PooledSolver&) = delete;
+  void operator=(const PooledSolver&) = delete;
+
+  Solver& operator*() const { return *s; }
+  Solver* operator->() const { return s; }
+};
+
+
 void solver_print_queries(bool yes);
 void solver_tactic_verbose(bool yes);
+// cache query results on disk in the given directory; empty string disables
+void solver_use_cache(std::string dir);
+// Use the given ','-separated list of tactics instead of the default one; an
+// empty string restores the default. Takes effect on the next solver_init().
+// Returns false if some tactic doesn't exist.
+bool solver_tactics(const std::string &desc);
+// Solve each query with several tactic pipelines in parallel. 'desc' is a
+// ':'-separated list of ','-separated tactic names, or "default" for the
+// built-in portfolio. An empty string disables. Returns false if some tactic
+// doesn't exist.
+bool solver_portfolio(const std::string &desc);
+void solver_incremental(bool yes);
+// Reuse solvers through PooledSolver rather than creating a fresh one per
+// query. Off by default: Z3_solver_reset() discards the solver's internals
+// anyway, so it saves little, and reset solvers may return different models.
+void solver_pool(bool yes);
+// default of Solver::useCEGIS() for new solvers; 0 disables
+void solver_cegis(unsigned max_iterations);
+// check the queries of Solver::check(common, queries) concurrently, on up to
+// one thread per core, each with its own context; doesn't apply to
+// incremental mode
+void solver_parallel(bool yes);
+// Write a JSON line per query to 'file' (time, per-tactic times, memory,
+// DAG size, result) and add a histogram of query times to the stats. An empty
+// string disables. Returns false if the file can't be opened.
+bool solver_profile(const std::string &file);
+// label this thread's queries in the profile and query dumps
+void solver_profile_transform(std::string name);
+// save each query as a standalone .smt2 file in 'dir'; empty string disables
+void solver_dump_queries(std::string dir);
+// run Solver::check(common, queries) both fresh and incrementally and time it
+void solver_bench_incremental(bool yes);
+// print timings of the current transform (since last solver_init())
+void solver_print_bench(std::ostream &os);
 void solver_print_stats(std::ostream &os);
 
 
+// Attributes the growth of Z3's allocations while it's alive to a job (e.g.,
+// a transform), so that the memory limit (see hit_memory_limit()) and the
+// memory stats are per job rather than for the whole process. Z3 only keeps
+// a process-wide estimate, so growth can only be attributed to a job while
+// its account is the only one alive; otherwise the limit falls back to the
+// process-wide estimate and queries are never skipped over it.
+// The constructing thread uses the account until it's destroyed; other
+// threads working for the same job join it with a Scope.
+class MemoryAccount {
+  uint64_t base;
+  std::atomic<uint64_t> peak_ = 0;
+  MemoryAccount *old;
+
+public:
+  MemoryAccount();
+  ~MemoryAccount();
+
+  // whether no other account is alive, so that used() is this job's alone
+  static bool exclusive();
+
+  // bytes allocated since construction (0 if there was a net release)
+  uint64_t used();
+  // the largest used() seen so far
+  uint64_t peak() const { return peak_; }
+
+  // the account of the calling thread, or null
+  static MemoryAccount* current();
+
+  // Makes 'a' (may be null) the calling thread's account while in scope
+  class Scope {
+    MemoryAccount *old;
+  public:
+    Scope(MemoryAccount *a);
+    ~Scope();
+  };
+};
+
+
 struct EnableSMTQueriesTMP {
   bool old;
   EnableSMTQueriesTMP();
@@ -4,7 +4,7 @@
 import lit.TestRunner
 import lit.util
 from .base import FileBasedTest
-import re, signal, string, subprocess
+import os, re, shutil, signal, string, subprocess, tempfile
 
 
 def executeCommand(command):
@@ -36,29 +36,48 @@ def readFile(path):
 
 
 class Alive2Test(FileBasedTest):
+  # A test runs alive once per '; TEST-ARGS:' line (or once without extra
+  # args), in order, and every run must give the expected result. '%t' in the
+  # args is a scratch path private to the test and shared by its runs, e.g.,
+  # for a query cache that a later run reads. Then alive-replay runs once per
+  # '; REPLAY-ARGS:' line and must exit with 0 (no mismatched verdicts). The
+  # output of the last run (stdout and stderr) must contain the text of each
+  # '; OUTPUT:' line.
   def __init__(self):
     self.regex_errs = re.compile(r";\s*(ERROR:.*)")
     self.regex_args = re.compile(r";\s*TEST-ARGS:(.*)")
+    self.regex_replay = re.compile(r";\s*REPLAY-ARGS:(.*)")
+    self.regex_out  = re.compile(r";\s*OUTPUT: (.*)")
 
   def execute(self, test, litConfig):
     test = test.getSourcePath()
-    cmd = ['./alive']
     input = readFile(test)
+    m = self.regex_errs.search(input)
+    runs = self.regex_args.findall(input) or ['']
 
-    # add test-specific args
-    m = self.regex_args.search(input)
-    if m != None:
-      cmd += m.group(1).split()
+    tmp = tempfile.mkdtemp()
+    subst = lambda args: args.replace('%t', os.path.join(tmp, 't')).split()
+    try:
+      for args in runs:
+        cmd = ['./alive'] + subst(args)
+        cmd.append(test)
+        out, err, exitCode = executeCommand(cmd)
 
-    cmd.append(test)
-    out, err, exitCode = executeCommand(cmd)
+        if m == None:
+          if exitCode != 0 or \
+             string.find(out, 'Optimization is correct!') == -1:
+            return lit.Test.FAIL, out + err
+        elif exitCode == 0 or string.find(err, m.group(1)) == -1:
+          return lit.Test.FAIL, out + err
 
-    m = self.regex_errs.search(input)
-    if m == None:
-      if exitCode == 0 and string.find(out, 'Optimization is correct!') != -1:
-        return lit.Test.PASS, ''
-      return lit.Test.FAIL, out + err
+      for args in self.regex_replay.findall(input):
+        out, err, exitCode = executeCommand(['./alive-replay'] + subst(args))
+        if exitCode != 0:
+          return lit.Test.FAIL, out + err
 
-    if exitCode != 0 and string.find(err, m.group(1)) != -1:
-      return lit.Test.PASS, ''
-    return lit.Test.FAIL, out + err
+      for text in self.regex_out.findall(input):
+        if string.find(out + err, text) == -1:
+          return lit.Test.FAIL, out + err
+    finally:
+      shutil.rmtree(tmp)
+    return lit.Test.PASS, ''
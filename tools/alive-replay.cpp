@@ -0,0 +1,330 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "smt/ctx.h"
+#include "smt/expr.h"
+#include "smt/smt.h"
+#include "smt/solver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <z3.h>
+
+#if __GNUC__ < 8
+# include <experimental/filesystem>
+  namespace fs = std::experimental::filesystem;
+#else
+# include <filesystem>
+  namespace fs = std::filesystem;
+#endif
+
+using namespace smt;
+using namespace std;
+
+namespace {
+
+struct Query {
+  fs::path path;
+  string expected;
+  string answer;
+  double time = 0;
+};
+
+void show_help() {
+  cerr <<
+    "Usage: alive-replay <options> <dirs or .smt2 files>\n"
+    "Re-solves the queries saved by alive -smt-dump.\n"
+    "Options:\n"
+    " -tactics:x\t\tTactic pipeline to use (tactic,tactic,..)\n"
+    " -param:name=value\tSet a Z3 global parameter\n"
+    " -config:file\t\tLoad the tactics and params from file\n"
+    " -smt-to:x\t\tTimeout for SMT queries in ms\n"
+    " -threads:x\t\tNumber of queries to solve concurrently\n"
+    " -sample:x\t\tOnly use x queries, evenly spread over the input\n"
+    " -autotune\t\tFind the fastest candidate pipeline that gives the\n"
+    "\t\t\tsame verdicts as recorded in the files\n"
+    " -candidates:file\tCandidate pipelines for -autotune, one per line\n"
+    " -h / --help\t\tShow this help\n";
+}
+
+// the answer recorded by alive in the file's header
+string read_expected(const string &text) {
+  istringstream is(text);
+  string line;
+  while (getline(is, line) && line.compare(0, 1, ";") == 0) {
+    string_view prefix = "; result: ";
+    if (line.compare(0, prefix.size(), prefix) == 0)
+      return line.substr(prefix.size());
+  }
+  return "";
+}
+
+bool definite(const string &answer) {
+  return answer == "sat" || answer == "unsat";
+}
+
+bool mismatch(const Query &q) {
+  return definite(q.expected) && definite(q.answer) && q.expected != q.answer;
+}
+
+// a recorded verdict that we didn't reproduce
+bool lost(const Query &q) {
+  return definite(q.expected) && q.answer != q.expected;
+}
+
+// the default pipeline ("") plus some cheaper and some more thorough ones
+const vector<string> default_candidates = {
+  "",
+  "simplify,smt",
+  "smt",
+  "simplify,propagate-values,simplify,elim-uncnstr,smt",
+  "simplify,propagate-values,simplify,elim-uncnstr,qfbv",
+  "simplify,propagate-values,simplify,elim-uncnstr,qe-light,simplify,"
+    "elim-uncnstr,qe-light,simplify,qfbv",
+};
+
+void solve(Query &q) {
+  ifstream f(q.path);
+  stringstream text;
+  text << f.rdbuf();
+  q.expected = read_expected(text.str());
+
+  auto c = ctx();
+  auto asserts = Z3_parse_smtlib2_string(c, text.str().c_str(), 0, nullptr,
+                                         nullptr, 0, nullptr, nullptr);
+  if (Z3_get_error_code(c) != Z3_OK) {
+    q.answer = "parse-error";
+    return;
+  }
+
+  Z3_ast_vector_inc_ref(c, asserts);
+  Solver s;
+  for (unsigned i = 0, e = Z3_ast_vector_size(c, asserts); i != e; ++i) {
+    s.add(expr(Z3_ast_vector_get(c, asserts, i)));
+  }
+  Z3_ast_vector_dec_ref(c, asserts);
+
+  auto start = chrono::steady_clock::now();
+  auto r = s.check();
+  chrono::duration<double> time = chrono::steady_clock::now() - start;
+
+  q.time = time.count();
+  q.answer = r.isSat() ? "sat" : r.isUnsat() ? "unsat" : "unknown";
+}
+
+// Solves the queries in 'num_threads' threads, each with its own context.
+// 'done' is called as each query finishes, one at a time.
+void run(vector<Query> &queries, unsigned num_threads,
+         const function<void(const Query&)> &done) {
+  atomic<unsigned> next(0);
+  mutex done_mutex;
+
+  vector<thread> threads;
+  for (unsigned i = 0; i != num_threads; ++i) {
+    threads.emplace_back([&]() {
+      smt_initializer smt_init;
+      Z3_set_error_handler(ctx(), [](Z3_context, Z3_error_code) {});
+
+      for (unsigned idx; (idx = next++) < queries.size(); ) {
+        auto &q = queries[idx];
+        solve(q);
+        smt_init.reset();
+        Z3_set_error_handler(ctx(), [](Z3_context, Z3_error_code) {});
+
+        if (done) {
+          lock_guard<mutex> lock(done_mutex);
+          done(q);
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+// Runs the queries with each candidate pipeline and picks the fastest one
+// that reproduces all verdicts recorded in the files
+int tune(vector<Query> &queries, unsigned num_threads,
+         const vector<string> &candidates) {
+  cout << "Autotuning with " << queries.size() << " queries\n\n"
+       << "     Time  Lost  Pipeline\n";
+
+  optional<pair<double, string>> best;
+  for (auto &desc : candidates) {
+    auto name = desc.empty() ? "(default)" : desc;
+    if (!solver_tactics(desc)) {
+      cerr << "Unknown tactic in " << desc << '\n';
+      continue;
+    }
+    run(queries, num_threads, nullptr);
+
+    double time = 0;
+    unsigned num_lost = 0;
+    for (auto &q : queries) {
+      time += q.time;
+      num_lost += lost(q);
+    }
+    cout << fixed << setprecision(2) << setw(8) << time << "s "
+         << setw(5) << num_lost << "  " << name << endl;
+
+    if (num_lost == 0 && (!best || time < best->first))
+      best.emplace(time, desc);
+  }
+
+  if (!best) {
+    cout << "\nNo candidate reproduced all verdicts\n";
+    return -1;
+  }
+  cout << "\nBest: " << (best->second.empty() ? "(default)" : best->second)
+       << '\n';
+  if (!best->second.empty())
+    cout << "Config line: tactics " << best->second << '\n';
+  return 0;
+}
+
+}
+
+
+int main(int argc, char **argv) {
+  unsigned num_threads = 1;
+  unsigned sample = 0;
+  bool autotune = false;
+  string candidates_file;
+
+  int argc_i = 1;
+  for (; argc_i < argc; ++argc_i) {
+    if (argv[argc_i][0] != '-')
+      break;
+
+    string_view arg(argv[argc_i]);
+    if (arg.compare(0, 9, "-tactics:") == 0 && arg.size() > 9) {
+      if (!solver_tactics(string(arg.substr(9)))) {
+        cerr << "Unknown tactic in " << arg << '\n';
+        return -1;
+      }
+    } else if (arg.compare(0, 7, "-param:") == 0 &&
+               arg.find('=') != string_view::npos) {
+      auto eq = arg.find('=');
+      set_solver_param(string(arg.substr(7, eq - 7)),
+                       string(arg.substr(eq + 1)));
+    } else if (arg.compare(0, 8, "-config:") == 0 && arg.size() > 8) {
+      auto err = load_solver_config(string(arg.substr(8)));
+      if (!err.empty()) {
+        cerr << err << '\n';
+        return -1;
+      }
+    } else if (arg.compare(0, 8, "-smt-to:") == 0 && arg.size() > 8)
+      set_query_timeout(string(arg.substr(8)));
+    else if (arg.compare(0, 9, "-threads:") == 0 && arg.size() > 9)
+      num_threads = max(1ul, strtoul(arg.substr(9).data(), nullptr, 10));
+    else if (arg.compare(0, 8, "-sample:") == 0 && arg.size() > 8)
+      sample = strtoul(arg.substr(8).data(), nullptr, 10);
+    else if (arg == "-autotune")
+      autotune = true;
+    else if (arg.compare(0, 12, "-candidates:") == 0 && arg.size() > 12)
+      candidates_file = arg.substr(12);
+    else if (arg == "-h" || arg == "--help") {
+      show_help();
+      return 0;
+    } else {
+      cerr << "Unknown argument: " << arg << "\n\n";
+      show_help();
+      return -1;
+    }
+  }
+
+  if (argc_i >= argc) {
+    show_help();
+    return -1;
+  }
+
+  vector<Query> queries;
+  for (; argc_i < argc; ++argc_i) {
+    fs::path path(argv[argc_i]);
+    if (fs::is_directory(path)) {
+      for (auto &entry : fs::directory_iterator(path)) {
+        if (entry.path().extension() == ".smt2")
+          queries.push_back({ entry.path() });
+      }
+    } else {
+      queries.push_back({ path });
+    }
+  }
+  sort(queries.begin(), queries.end(),
+       [](auto &a, auto &b) { return a.path < b.path; });
+
+  if (sample && sample < queries.size()) {
+    vector<Query> sampled;
+    for (unsigned i = 0; i != sample; ++i) {
+      sampled.emplace_back(move(queries[(size_t)i * queries.size() / sample]));
+    }
+    queries = move(sampled);
+  }
+
+  // The main thread keeps a context alive so that workers' contexts come and
+  // go without resetting Z3's global state
+  smt_initializer smt_init;
+
+  if (autotune) {
+    vector<string> candidates = default_candidates;
+    if (!candidates_file.empty()) {
+      ifstream f(candidates_file);
+      if (!f) {
+        cerr << "Couldn't open " << candidates_file << '\n';
+        return -1;
+      }
+      candidates.clear();
+      for (string line; getline(f, line); ) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t") != string::npos)
+          candidates.emplace_back(line);
+      }
+    }
+    return tune(queries, num_threads, candidates);
+  }
+
+  auto start = chrono::steady_clock::now();
+  run(queries, num_threads, [](const Query &q) {
+    cout << fixed << setprecision(1) << q.path.filename().string() << '\t'
+         << q.answer << '\t' << q.time * 1000 << " ms";
+    if (mismatch(q))
+      cout << "\tMISMATCH (expected " << q.expected << ')';
+    cout << endl;
+  });
+  chrono::duration<double> wall = chrono::steady_clock::now() - start;
+
+  double total = 0;
+  unsigned num_sat = 0, num_unsat = 0, num_unknown = 0, num_mismatch = 0;
+  for (auto &q : queries) {
+    total += q.time;
+    num_sat     += q.answer == "sat";
+    num_unsat   += q.answer == "unsat";
+    num_unknown += q.answer != "sat" && q.answer != "unsat";
+    num_mismatch += mismatch(q);
+  }
+
+  cout << fixed << setprecision(2)
+       << "\n------------------ REPLAY STATS -----------------\n"
+          "Num queries: " << queries.size() << "\n"
+          "Num SAT:     " << num_sat << "\n"
+          "Num UNSAT:   " << num_unsat << "\n"
+          "Num unknown: " << num_unknown << "\n"
+          "Mismatches:  " << num_mismatch << "\n"
+          "Solve time:  " << total << " s\n"
+          "Wall time:   " << wall.count() << " s\n";
+
+  return num_mismatch;
+}
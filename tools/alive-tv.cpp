@@ -67,6 +67,16 @@ static llvm::cl::opt<bool> opt_smt_verbose(
     "tv-smt-verbose", llvm::cl::desc("Alive: SMT verbose mode"),
     llvm::cl::init(false));
 
+static llvm::cl::opt<std::string> opt_smt_cache(
+    "tv-smt-cache", llvm::cl::desc("Alive: cache SMT query results on disk"),
+    llvm::cl::value_desc("directory"), llvm::cl::cat(opt_alive));
+
+static llvm::cl::opt<std::string> opt_cex_db(
+    "tv-cex-db",
+    llvm::cl::desc("Alive: keep the inputs of counterexamples on disk and "
+                   "try them first on later functions"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(opt_alive));
+
 static llvm::cl::opt<bool> opt_bidirectional("bidirectional",
     llvm::cl::init(false), llvm::cl::cat(opt_alive),
     llvm::cl::desc("Alive: Run refinement check in both directions (default=false)"));
@@ -213,6 +223,8 @@ int main(int argc, char **argv) {
 
   smt::solver_print_queries(opt_smt_verbose);
   smt::solver_tactic_verbose(false);
+  smt::solver_use_cache(opt_smt_cache);
+  use_counterexample_db(opt_cex_db);
   smt::set_query_timeout(to_string(opt_smt_to));
   smt::set_memory_limit(1024 * 1024 * 1024);
   //config::skip_smt = opt_smt_skip;
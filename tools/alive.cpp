@@ -2,13 +2,18 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "ir/function.h"
+#include "smt/budget.h"
 #include "smt/smt.h"
 #include "smt/solver.h"
 #include "tools/alive_parser.h"
+#include "tools/transform.h"
 #include "util/config.h"
 #include "util/file.h"
+#include "util/symexec.h"
 #include <cstdlib>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -51,9 +56,37 @@ static void show_help() {
     " -smt-to:x\t\tTimeout for SMT queries in ms\n"
     " -max-mem:x\t\tMax memory consumption in MB (aprox)\n"
     " -smt-verbose\t\tPrint all SMT queries\n"
+    " -smt-cache:dir\t\tCache SMT query results in the given directory\n"
+    " -smt-tactics:x\t\tTactic pipeline to use (tactic,tactic,..)\n"
+    " -smt-param:n=v\t\tSet a Z3 global parameter\n"
+    " -smt-config:file\tLoad the tactics and params from file\n"
+    " -smt-incremental\tShare a solver between the refinement queries\n"
+    " -smt-pool\t\tReuse solvers across queries instead of creating them\n"
+    " -smt-parallel\t\tCheck the refinement queries concurrently\n"
+    " -smt-profile:file\tWrite a JSON line per SMT query to file\n"
+    " -smt-dump:dir\t\tSave each SMT query as an .smt2 file in dir\n"
+    " -smt-portfolio[:x]\tRace several tactic pipelines on each query\n"
+    "\t\t\t(x = tactic,tactic,..:tactic,..)\n"
+    " -smt-bench-incremental\tTime fresh vs incremental solving\n"
+    " -smt-cegis[:x]\t\tSolve quantified queries with a CEGIS loop instead of\n"
+    "\t\t\tMBQI, trying up to x candidates (default: 1000)\n"
+    " -batch-to:x\t\tRun all transforms with an x ms timeout first, then\n"
+    "\t\t\tretry the ones that timed out with growing timeouts\n"
+    " -batch-budget:x\tTime budget in seconds for -batch-to (default: 600)\n"
+    " -transform-budget:x\tWall-clock time budget per transform in ms; the\n"
+    "\t\t\tremaining queries are canceled once it runs out\n"
+    " -typing-threads:x\tVerify up to x typings of a transform concurrently\n"
+    " -concrete-runs:x\tRun src and tgt on x concrete inputs to look for a\n"
+    "\t\t\tcounterexample before SMT (default: 0, disabled)\n"
+    " -cex-db:file\t\tKeep the inputs of counterexamples in the given file\n"
+    "\t\t\tand try them first on later transforms\n"
+    " -exhaustive-bits:x\tVerify on all inputs, without SMT, if they have at\n"
+    "\t\t\tmost x bits in total (default: 0, disabled)\n"
     " -skip-smt\t\tSkip all SMT queries\n"
     " -disable-poison-input\tAssume input variables can never be poison\n"
     " -disable-undef-input\tAssume input variables can never be undef\n"
+    " -split-undef\t\tCheck each instantiation of the undef inputs' types as\n"
+    "\t\t\tits own query (concurrently with -smt-parallel)\n"
     " -h / --help\t\tShow this help\n";
 }
 
@@ -62,6 +95,11 @@ int main(int argc, char **argv) {
   bool verbose = false;
   bool show_smt_stats = false;
   bool root_only = false;
+  bool bench_incremental = false;
+  unsigned batch_timeout = 0;
+  double batch_budget = 600;
+  unsigned typing_threads = 1;
+  unsigned transform_budget = 0;
 
   int argc_i = 1;
   for (; argc_i < argc; ++argc_i) {
@@ -82,14 +120,75 @@ int main(int argc, char **argv) {
                             1024 * 1024);
     else if (arg == "-smt-verbose")
       smt::solver_print_queries(true);
+    else if (arg.compare(0, 11, "-smt-cache:") == 0 && arg.size() > 11)
+      smt::solver_use_cache(string(arg.substr(11)));
+    else if (arg == "-smt-portfolio" ||
+             (arg.compare(0, 15, "-smt-portfolio:") == 0 && arg.size() > 15)) {
+      if (!smt::solver_portfolio(arg.size() > 15 ? string(arg.substr(15))
+                                                 : "default")) {
+        cerr << "Unknown tactic in " << arg << '\n';
+        return -1;
+      }
+    } else if (arg.compare(0, 13, "-smt-tactics:") == 0 && arg.size() > 13) {
+      if (!smt::solver_tactics(string(arg.substr(13)))) {
+        cerr << "Unknown tactic in " << arg << '\n';
+        return -1;
+      }
+    } else if (arg.compare(0, 11, "-smt-param:") == 0 &&
+               arg.find('=') != string_view::npos) {
+      auto eq = arg.find('=');
+      smt::set_solver_param(string(arg.substr(11, eq - 11)),
+                            string(arg.substr(eq + 1)));
+    } else if (arg.compare(0, 12, "-smt-config:") == 0 && arg.size() > 12) {
+      auto err = smt::load_solver_config(string(arg.substr(12)));
+      if (!err.empty()) {
+        cerr << err << '\n';
+        return -1;
+      }
+    } else if (arg == "-smt-incremental")
+      smt::solver_incremental(true);
+    else if (arg == "-smt-pool")
+      smt::solver_pool(true);
+    else if (arg == "-smt-cegis")
+      smt::solver_cegis(1000);
+    else if (arg.compare(0, 11, "-smt-cegis:") == 0 && arg.size() > 11)
+      smt::solver_cegis(strtoul(arg.substr(11).data(), nullptr, 10));
+    else if (arg.compare(0, 10, "-smt-dump:") == 0 && arg.size() > 10)
+      smt::solver_dump_queries(string(arg.substr(10)));
+    else if (arg.compare(0, 13, "-smt-profile:") == 0 && arg.size() > 13) {
+      if (!smt::solver_profile(string(arg.substr(13)))) {
+        cerr << "Couldn't open " << arg.substr(13) << '\n';
+        return -1;
+      }
+      show_smt_stats = true;
+    } else if (arg == "-smt-parallel")
+      smt::solver_parallel(true);
+    else if (arg == "-smt-bench-incremental")
+      bench_incremental = true;
+    else if (arg.compare(0, 10, "-batch-to:") == 0 && arg.size() > 10)
+      batch_timeout = strtoul(arg.substr(10).data(), nullptr, 10);
+    else if (arg.compare(0, 14, "-batch-budget:") == 0 && arg.size() > 14)
+      batch_budget = strtod(arg.substr(14).data(), nullptr);
+    else if (arg.compare(0, 18, "-transform-budget:") == 0 && arg.size() > 18)
+      transform_budget = strtoul(arg.substr(18).data(), nullptr, 10);
+    else if (arg.compare(0, 16, "-typing-threads:") == 0 && arg.size() > 16)
+      typing_threads = strtoul(arg.substr(16).data(), nullptr, 10);
     else if (arg == "-tactic-verbose")
       smt::solver_tactic_verbose(true);
+    else if (arg.compare(0, 15, "-concrete-runs:") == 0 && arg.size() > 15)
+      config::concrete_runs = strtoul(arg.substr(15).data(), nullptr, 10);
+    else if (arg.compare(0, 8, "-cex-db:") == 0 && arg.size() > 8)
+      use_counterexample_db(string(arg.substr(8)));
+    else if (arg.compare(0, 17, "-exhaustive-bits:") == 0 && arg.size() > 17)
+      config::exhaustive_bits = strtoul(arg.substr(17).data(), nullptr, 10);
     else if (arg == "-skip-smt")
       config::skip_smt = true;
     else if (arg == "-disable-undef-input")
       config::disable_undef_input = true;
     else if (arg == "-disable-poison-input")
       config::disable_poison_input = true;
+    else if (arg == "-split-undef")
+      config::split_undef_instances = true;
     else if (arg == "-h" || arg == "--help") {
       show_help();
       return 0;
@@ -108,6 +207,7 @@ int main(int argc, char **argv) {
   if (verbose) {
     config::symexec_print_each_value = true;
   }
+  smt::solver_bench_incremental(bench_incremental);
 
   smt::smt_initializer smt_init;
   parser_initializer parser_init;
@@ -117,43 +217,65 @@ int main(int argc, char **argv) {
 
   unsigned num_errors = 0;
 
+  auto verify = [&](Transform &t) -> Errors {
+    smt_init.reset();
+    smt::solver_profile_transform(t.name);
+    t.print(cout, print_opts);
+    cout << '\n';
+
+    smt::TimeBudget budget(transform_budget);
+    smt::MemoryAccount memory;
+    TransformVerify tv(t, !root_only);
+    Errors errs;
+    if (typing_threads > 1) {
+      errs = tv.verifyParallel(typing_threads, cout);
+    } else {
+      auto types = tv.getTypings();
+      if (!types)
+        return types.timedOut() ? timeout_error() : "Doesn't type check!";
+
+      unsigned i = 0;
+      for (; types; ++types) {
+        tv.fixupTypes(types);
+        if ((errs = tv.verify()))
+          break;
+        cout << "\rDone: " << ++i << flush;
+      }
+      if (!errs && types.timedOut())
+        errs = timeout_error();
+    }
+    cout << '\n';
+    if (bench_incremental)
+      smt::solver_print_bench(cout);
+    return errs;
+  };
+
+  auto report = [&](Transform &t, const Errors &errs) {
+    if (errs) {
+      cerr << errs;
+      ++num_errors;
+    } else {
+      cout << "Optimization is correct!\n";
+    }
+  };
+
+  optional<TransformBatch> batch;
+  if (batch_timeout)
+    batch.emplace(batch_timeout, batch_budget, verify, report);
+
   for (; argc_i < argc; ++argc_i) {
     cout << "Processing " << argv[argc_i] << "..\n";
     try {
       for (auto &t : parse(*file_reader(argv[argc_i], PARSER_READ_AHEAD))) {
-        smt_init.reset();
-
         if (root_only && (!add_return(t.src) || !add_return(t.tgt))) {
           ++num_errors;
           continue;
         }
 
-        t.print(cout, print_opts);
-        cout << '\n';
-
-        TransformVerify tv(t, !root_only);
-        auto types = tv.getTypings();
-        if (!types) {
-          cerr << "Doesn't type check!\n";
-          ++num_errors;
-          continue;
-        }
-
-        unsigned i = 0;
-        bool correct = true;
-        for (; types; ++types) {
-          tv.fixupTypes(types);
-          if (auto errs = tv.verify()) {
-            cerr << errs;
-            ++num_errors;
-            correct = false;
-            break;
-          }
-          cout << "\rDone: " << ++i << flush;
-        }
-        cout << '\n';
-        if (correct)
-          cout << "Optimization is correct!\n";
+        if (batch)
+          batch->run(move(t));
+        else
+          report(t, verify(t));
       }
     } catch (const FileIOException &e) {
       cerr << "Couldn't read the file" << endl;
@@ -164,8 +286,15 @@ int main(int argc, char **argv) {
     }
   }
 
-  if (show_smt_stats)
+  if (batch) {
+    batch->finish(cout);
+    batch->printSummary(cout);
+  }
+
+  if (show_smt_stats) {
     smt::solver_print_stats(cout);
+    sym_exec_print_stats(cout);
+  }
 
   return num_errors;
 }
@@ -911,6 +911,8 @@ vector<Transform> parse(string_view buf) {
   vector<Transform> ret;
 
   yylex_init(buf);
+  // drop the END token left over from a previous parse
+  tokenizer = tokenizer_t();
 
   while (!tokenizer.empty()) {
     auto &t = ret.emplace_back();
@@ -0,0 +1,100 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+// Measures the cost of wrapping the ASTs returned by Z3 in smt::expr. The
+// constructor checks whether each one is a numeral that can be kept inline,
+// which costs a Z3_get_ast_kind call even for the (common) symbolic terms.
+
+#include "smt/ctx.h"
+#include "smt/expr.h"
+#include "smt/smt.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <z3.h>
+
+using namespace smt;
+using namespace std;
+
+namespace {
+
+volatile uintptr_t sink;
+
+template <typename Fn>
+double ns_per_ast(unsigned reps, const vector<Z3_ast> &asts, Fn &&fn) {
+  auto start = chrono::steady_clock::now();
+  for (unsigned r = 0; r < reps; ++r) {
+    for (auto a : asts) {
+      fn(a);
+    }
+  }
+  chrono::duration<double, nano> t = chrono::steady_clock::now() - start;
+  return t.count() / ((double)reps * asts.size());
+}
+
+void print(const char *what, double ns) {
+  cout << left << setw(34) << what << fixed << setprecision(1) << ns
+       << " ns\n";
+}
+
+}
+
+int main(int argc, char **argv) {
+  unsigned reps = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+  smt_initializer smt_init;
+  auto c = ctx();
+
+  // symbolic terms, wide numerals (checked but not inlined), and narrow ones
+  vector<Z3_ast> terms, wide, narrow;
+  for (unsigned i = 0; i < 1000; ++i) {
+    auto sort = Z3_mk_bv_sort(c, 8 + i % 57);
+    auto x = Z3_mk_const(c, Z3_mk_int_symbol(c, i), sort);
+    terms.push_back(Z3_mk_bvadd(c, x, x));
+    Z3_inc_ref(c, terms.back());
+    wide.push_back(Z3_mk_numeral(c, to_string(i).c_str(),
+                                 Z3_mk_bv_sort(c, 64)));
+    Z3_inc_ref(c, wide.back());
+    narrow.push_back(Z3_mk_numeral(c, to_string(i).c_str(),
+                                   Z3_mk_bv_sort(c, 32)));
+    Z3_inc_ref(c, narrow.back());
+  }
+
+  double kind = ns_per_ast(reps, terms, [&](Z3_ast a) {
+    sink = sink + Z3_get_ast_kind(c, a);
+  });
+  double wrap = ns_per_ast(reps, terms, [&](Z3_ast a) {
+    expr e(a);
+    sink = sink + e.isValid();
+  });
+  double build = ns_per_ast(reps, terms, [&](Z3_ast a) {
+    expr e(Z3_mk_bvmul(c, a, a));
+    sink = sink + e.isValid();
+  });
+  double wrap_wide = ns_per_ast(reps, wide, [&](Z3_ast a) {
+    expr e(a);
+    sink = sink + e.isValid();
+  });
+  double wrap_narrow = ns_per_ast(reps, narrow, [&](Z3_ast a) {
+    expr e(a);
+    sink = sink + e.isValid();
+  });
+
+  print("Z3_get_ast_kind (term)", kind);
+  print("expr(Z3_ast) (term)", wrap);
+  print("expr(Z3_mk_bvmul) (term)", build);
+  print("expr(Z3_ast) (64-bit numeral)", wrap_wide);
+  print("expr(Z3_ast) (32-bit numeral)", wrap_narrow);
+  cout << "Kind check share of wrapping a term: " << setprecision(1)
+       << 100 * kind / wrap << "%, of building one: " << 100 * kind / build
+       << "%\n";
+
+  for (auto &v : { terms, wide, narrow }) {
+    for (auto a : v) {
+      Z3_dec_ref(c, a);
+    }
+  }
+  return 0;
+}
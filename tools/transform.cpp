@@ -2,31 +2,46 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "tools/transform.h"
+#include "ir/constant.h"
+#include "ir/interp.h"
 #include "ir/state.h"
+#include "smt/budget.h"
+#include "smt/ctx.h"
 #include "smt/expr.h"
 #include "smt/smt.h"
 #include "smt/solver.h"
 #include "util/config.h"
 #include "util/errors.h"
+#include "util/lru_cache.h"
 #include "util/symexec.h"
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <set>
 #include <sstream>
+#include <string>
 #include <string_view>
+#include <thread>
 
 using namespace IR;
 using namespace smt;
 using namespace tools;
 using namespace util;
 using namespace std;
+namespace fs = std::filesystem;
 
 
 static bool is_undef(const expr &e) {
   if (e.isConst())
     return false;
-  Solver s;
-  s.add(expr::mkForAll(e.vars(), expr::mkVar("#undef", e) != e));
-  return s.check().isUnsat();
+  PooledSolver s;
+  s->add(expr::mkForAll(e.vars(), expr::mkVar("#undef", e) != e));
+  return s->check().isUnsat();
 }
 
 static void print_varval(ostream &s, State &st, const Model &m,
@@ -77,6 +92,13 @@ static void print_varval(ostream &s, State &st, const Model &m,
 }
 
 
+const char* tools::timeout_error() {
+  if (hit_memory_limit())
+    return "Out of memory; skipping function.";
+  auto *budget = TimeBudget::current();
+  return budget && budget->exceeded() ? "Budget exceeded" : "Timeout";
+}
+
 void tools::error(Errors &errs, State &src_state, State &tgt_state,
                   const Result &r, bool print_var, const Value *var,
                   const Type &type,
@@ -89,7 +111,7 @@ void tools::error(Errors &errs, State &src_state, State &tgt_state,
   }
 
   if (r.isUnknown()) {
-    errs.add("Timeout");
+    errs.add(timeout_error());
     return;
   }
 
@@ -151,6 +173,16 @@ void tools::error(Errors &errs, State &src_state, State &tgt_state,
 
 expr tools::preprocess(Transform &t, const set<expr> &qvars,
                        const set<expr> &undef_qvars, expr && e) {
+  expr insts(false);
+  for (auto &inst : preprocess_instances(t, qvars, undef_qvars, move(e))) {
+    insts |= inst;
+  }
+  return insts;
+}
+
+vector<expr> tools::preprocess_instances(Transform &t, const set<expr> &qvars,
+                                         const set<expr> &undef_qvars,
+                                         expr &&e) {
 
   // restrict type variable from taking disabled values
   for (auto &i : t.src.getInputs()) {
@@ -162,12 +194,17 @@ expr tools::preprocess(Transform &t, const set<expr> &qvars,
       e &= var.extract(1, 1) == 0;
   }
 
-  if (qvars.empty() || e.isFalse())
-    return move(e);
+  vector<expr> insts;
+  if (qvars.empty() || e.isFalse()) {
+    insts.emplace_back(move(e));
+    return insts;
+  }
 
   // TODO: maybe try to instantiate undet_xx vars?
-  if (undef_qvars.empty() || hit_half_memory_limit())
-    return expr::mkForAll(qvars, move(e));
+  if (undef_qvars.empty() || hit_half_memory_limit()) {
+    insts.emplace_back(expr::mkForAll(qvars, move(e)));
+    return insts;
+  }
 
   // manually instantiate all ty_%v vars
   map<expr, expr> instances({ { move(e), true } });
@@ -179,10 +216,17 @@ expr tools::preprocess(Transform &t, const set<expr> &qvars,
     auto var = static_cast<const Input&>(i).getTyVar();
 
     for (auto &[e, v] : instances) {
+      // instances that simplify to the same formula keep all their tags
+      auto add = [&](expr &&inst, expr &&tag) {
+        auto [I, inserted] = instances2.try_emplace(move(inst), tag);
+        if (!inserted)
+          I->second |= move(tag);
+      };
+
       for (unsigned i = 0; i <= 2; ++i) {
         expr newexpr = e.subst(var, nums[i]);
         if (newexpr.eq(e)) {
-          instances2[move(newexpr)] = v;
+          add(move(newexpr), expr(v));
           break;
         }
 
@@ -191,7 +235,7 @@ expr tools::preprocess(Transform &t, const set<expr> &qvars,
           continue;
 
         // keep 'var' variables for counterexample printing
-        instances2[move(newexpr)] = v && var == nums[i];
+        add(move(newexpr), v && var == nums[i]);
       }
     }
     instances = move(instances2);
@@ -201,9 +245,8 @@ expr tools::preprocess(Transform &t, const set<expr> &qvars,
       break;
   }
 
-  expr insts(false);
   for (auto &[e, v] : instances) {
-    insts |= expr::mkForAll(qvars, move(const_cast<expr&>(e))) && v;
+    insts.emplace_back(expr::mkForAll(qvars, move(const_cast<expr&>(e))) && v);
   }
 
   // TODO: try out instantiating the undefs in forall quantifier
@@ -212,12 +255,623 @@ expr tools::preprocess(Transform &t, const set<expr> &qvars,
 }
 
 
+// Corner values tried by screen() before random ones: 0, 1, -1, INT_MIN,
+// INT_MAX and a few small powers of two.
+static constexpr unsigned num_corner_values = 8;
+
+static APInt corner_value(unsigned bits, unsigned idx) {
+  auto smin = APInt(bits, 1).shl(bits - 1);
+  switch (idx) {
+  case 0:  return APInt(bits);
+  case 1:  return APInt(bits, 1);
+  case 2:  return APInt::allOnes(bits);
+  case 3:  return smin;
+  case 4:  return ~smin;
+  default: return APInt(bits, 1).shl((idx - 4) % bits);
+  }
+}
+
+static APInt random_value(mt19937_64 &rng, unsigned bits) {
+  switch (rng() % 4) {
+  case 0:
+    return corner_value(bits, rng() % num_corner_values);
+  case 1:
+    // small values make sense as shift amounts and bit indexes
+    return APInt(bits, rng() % (2 * bits));
+  }
+
+  APInt r(min(bits, 64u), rng());
+  for (unsigned done = 64; done < bits; done += 64) {
+    r = APInt(min(bits - done, 64u), rng()).concat(r);
+  }
+  return r;
+}
+
+// The order in which check_refinement() checks for each kind of bug
+enum BugKind { MoreDefined, MorePoisonous, ValueMismatch, NoBug };
+
+static BugKind refines(const ConcreteVal *src, const ConcreteVal *tgt) {
+  if (!src || !tgt || src->poison)
+    return NoBug;
+  if (tgt->poison)
+    return MorePoisonous;
+  return src->v == tgt->v ? NoBug : ValueMismatch;
+}
+
+// name -> (bits, input); constant inputs have no type variable
+using InputVars = map<string, pair<unsigned, const Input*>>;
+
+// false if some input isn't an integer, or has different types in src and tgt
+static bool collect_inputs(const Transform &t, InputVars &vars) {
+  auto add = [&](const Value &val, const Input *in) {
+    if (!val.getType().isIntType())
+      return false;
+    auto [I, inserted] = vars.try_emplace(val.getName(), val.bits(), in);
+    return inserted || I->second.first == val.bits();
+  };
+  for (auto *fn : { &t.src, &t.tgt }) {
+    for (auto &i : fn->getInputs()) {
+      if (!add(i, static_cast<const Input*>(&i)))
+        return false;
+    }
+    for (auto &c : fn->getConstants()) {
+      if (dynamic_cast<const ConstantInput*>(&c) && !add(c, nullptr))
+        return false;
+    }
+  }
+  return true;
+}
+
+// The inputs of past counterexamples, most recently used first. A few values
+// (0, 1, -1, INT_MIN, ...) break transform after transform, so screen() tries
+// these before anything else on transforms with the same input types. Only
+// integer inputs that aren't undef or poison are stored, in the order of
+// InputVars. Entries are keyed by their text form, which is also the line of
+// the file they persist in: "bits:binary" per input.
+namespace {
+class CounterexampleDB {
+  static constexpr unsigned max_entries = 256;
+  LRUCache<string, vector<APInt>> entries{max_entries};
+  string file;
+  mutex m;
+
+  static string to_text(const vector<APInt> &vals) {
+    string s;
+    for (auto &v : vals) {
+      if (!s.empty())
+        s += ' ';
+      s += to_string(v.bits());
+      s += ':';
+      for (unsigned i = v.bits(); i-- > 0; ) {
+        s += v.bit(i) ? '1' : '0';
+      }
+    }
+    return s;
+  }
+
+  static optional<vector<APInt>> from_text(const string &line) {
+    vector<APInt> vals;
+    istringstream is(line);
+    string val;
+    while (is >> val) {
+      auto colon = val.find(':');
+      if (colon == string::npos)
+        return {};
+      auto bits = strtoul(val.c_str(), nullptr, 10);
+      string_view digits = string_view(val).substr(colon + 1);
+      if (bits == 0 || digits.size() != bits ||
+          digits.find_first_not_of("01") != string_view::npos)
+        return {};
+      vals.emplace_back(APInt::fromBinary(bits, digits));
+    }
+    return vals;
+  }
+
+  // rewrites the whole file, through a temp file so concurrent runs never see
+  // a partial one
+  void save() const {
+    fs::path tmp = file + ".tmp" + to_string(random_device()());
+    {
+      ofstream f(tmp);
+      for (auto &[key, vals] : entries) {
+        f << key << '\n';
+      }
+      if (!f)
+        return;
+    }
+    error_code ec;
+    fs::rename(tmp, file, ec);
+    if (ec)
+      fs::remove(tmp, ec);
+  }
+
+public:
+  void useFile(string &&f) {
+    lock_guard lock(m);
+    if (f == file)
+      return;
+    file = move(f);
+    entries.clear();
+    if (file.empty())
+      return;
+
+    // the file has the most recent first
+    ifstream is(file);
+    vector<vector<APInt>> loaded;
+    string line;
+    while (loaded.size() < max_entries && getline(is, line)) {
+      if (auto vals = from_text(line); vals && !vals->empty())
+        loaded.emplace_back(move(*vals));
+    }
+    for (auto I = loaded.rbegin(), E = loaded.rend(); I != E; ++I) {
+      auto key = to_text(*I);
+      entries.insert(key, move(*I));
+    }
+  }
+
+  // the stored inputs for transforms with these input types
+  vector<vector<APInt>> lookup(const InputVars &vars) {
+    vector<vector<APInt>> ret;
+    lock_guard lock(m);
+    for (auto &[key, vals] : entries) {
+      if (vals.size() != vars.size())
+        continue;
+      auto I = vars.begin();
+      bool same_types = all_of(vals.begin(), vals.end(), [&](auto &v) {
+        return v.bits() == (I++)->second.first;
+      });
+      if (same_types)
+        ret.emplace_back(vals);
+    }
+    return ret;
+  }
+
+  // adds or marks as used the inputs of a model of a failed query
+  void add(const Transform &t, const Model &model) {
+    InputVars vars;
+    if (!collect_inputs(t, vars) || vars.empty())
+      return;
+
+    vector<APInt> vals;
+    for (auto &[name, var] : vars) {
+      auto &[bits, in] = var;
+      uint64_t kind;
+      if (in && (!model[in->getTyVar()].isUInt(kind) || kind != 0))
+        return;
+      auto val = model[expr::mkVar(name.c_str(), bits)].getAPInt();
+      if (!val)
+        return;
+      vals.emplace_back(move(*val));
+    }
+
+    auto key = to_text(vals);
+    lock_guard lock(m);
+    if (!entries.find(key))
+      entries.insert(key, move(vals));
+    if (!file.empty())
+      save();
+  }
+};
+}
+
+static CounterexampleDB counterexample_db;
+
+void tools::use_counterexample_db(string file) {
+  counterexample_db.useFile(move(file));
+}
+
+// Runs src and tgt on concrete inputs to look for a counterexample before
+// going to SMT. Returns a constraint that pins the inputs to the values of
+// a run where the target doesn't refine the source. Inputs are never undef or
+// poison, so runs can miss bugs; the pinned queries confirm each candidate.
+static optional<expr>
+screen(const Transform &t, bool check_each_var,
+       const unordered_map<string, const Instr*> &tgt_instrs) {
+  auto runs = config::concrete_runs;
+  if (runs == 0 || config::skip_smt)
+    return {};
+
+  InputVars vars;
+  if (!collect_inputs(t, vars))
+    return {};
+
+  uint64_t corner_runs = 1;
+  for (unsigned i = 0, e = vars.size(); i != e && corner_runs < runs; ++i) {
+    corner_runs *= num_corner_values;
+  }
+  corner_runs = min(corner_runs, (uint64_t)runs / 2);
+  if (vars.empty())
+    runs = 1;
+
+  // the inputs of past counterexamples go first, on top of the other runs
+  auto stored = counterexample_db.lookup(vars);
+  runs += stored.size();
+
+  mt19937_64 rng(0);
+  unordered_map<string, APInt> inputs;
+  // the (value index, kind) of the first bug the SMT queries would report if
+  // it were the only one; keep the run with the earliest, so the report is
+  // usually the same as without screening
+  pair<unsigned, BugKind> best(UINT_MAX, NoBug);
+  optional<expr> pin;
+
+  for (unsigned run = 0; run != runs; ++run) {
+    inputs.clear();
+    if (run < stored.size()) {
+      unsigned idx = 0;
+      for (auto &[name, var] : vars) {
+        inputs.emplace(name, move(stored[run][idx++]));
+      }
+    } else {
+      unsigned n = run - stored.size(), idx = n;
+      for (auto &[name, var] : vars) {
+        auto bits = var.first;
+        inputs.emplace(name, n < corner_runs
+                               ? corner_value(bits, idx % num_corner_values)
+                               : random_value(rng, bits));
+        idx /= num_corner_values;
+      }
+    }
+
+    Interpreter src(t.src, inputs), tgt(t.tgt, inputs);
+    try {
+      src.run();
+      // the source's undef and freeze choices are universally quantified;
+      // taking them as zero may flag correct transforms
+      if (src.isNondet() || (src.isUB() && !check_each_var))
+        continue;
+      tgt.run();
+    } catch (UnsupportedEval&) {
+      return {};
+    }
+
+    pair<unsigned, BugKind> bug(0, NoBug);
+    if (check_each_var) {
+      for (auto &i : t.src.instrs()) {
+        auto &name = i.getName();
+        auto I = tgt_instrs.find(name);
+        if (name[0] != '%' || I == tgt_instrs.end())
+          continue;
+        bug.second = refines(src.get(i), tgt.get(*I->second));
+        if (bug.second != NoBug)
+          break;
+        ++bug.first;
+      }
+    }
+
+    if (bug.second == NoBug && !src.isUB())
+      bug.second = tgt.isUB() ? MoreDefined
+                              : refines(src.returnVal(), tgt.returnVal());
+
+    if (bug.second == NoBug || bug >= best)
+      continue;
+
+    best = bug;
+    pin = true;
+    for (auto &[name, var] : vars) {
+      auto &[bits, in] = var;
+      *pin &= expr::mkVar(name.c_str(), bits) ==
+                expr::mkAPInt(inputs.at(name));
+      if (in)
+        *pin &= in->getTyVar() == 0;
+    }
+
+    if (best == make_pair(0u, MoreDefined))
+      break;
+  }
+  return pin;
+}
+
+// Bounds for the undef inputs in exhaustive(): each assignment with an undef
+// input is a run with sets of values, whose size multiplies at each operand.
+// The search for a bug the SMT queries would report before one found already
+// gets a smaller budget.
+static constexpr uint64_t max_undef_assignments = 1 << 20;
+static constexpr unsigned max_undef_steps = 1 << 18;
+static constexpr unsigned max_undef_steps_after_bug = 1 << 14;
+
+// word j has bit j of the lane numbers
+static constexpr uint64_t lane_bits[] = {
+  0xAAAAAAAAAAAAAAAA, 0xCCCCCCCCCCCCCCCC, 0xF0F0F0F0F0F0F0F0,
+  0xFF00FF00FF00FF00, 0xFFFF0000FFFF0000, 0xFFFFFFFF00000000
+};
+
+enum class Exhaustive { Skipped, Correct, Incorrect };
+
+// Verifies transforms with narrow inputs by running src and tgt on every
+// assignment of the inputs: values and poison 64 at a time, bit-sliced, and
+// undef through the set semantics of Interpreter. On a bug, 'pin' is set to
+// the inputs of the one the SMT queries would report first. Anything the
+// interpreters don't support (e.g., branches, freeze of poison, undef
+// constants) skips it.
+static Exhaustive
+exhaustive(const Transform &t, bool check_each_var,
+           const unordered_map<string, const Instr*> &tgt_instrs, expr &pin) {
+  if (config::exhaustive_bits == 0 || config::skip_smt ||
+      config::symexec_print_each_value)
+    return Exhaustive::Skipped;
+
+  InputVars vars;
+  if (!collect_inputs(t, vars))
+    return Exhaustive::Skipped;
+  unsigned total_bits = 0;
+  for (auto &[name, var] : vars) {
+    total_bits += var.first;
+  }
+  if (total_bits > config::exhaustive_bits)
+    return Exhaustive::Skipped;
+
+  // the values compared in check_each_var mode, in the order of verify()
+  vector<pair<const Value*, const Value*>> cmp_vars;
+  if (check_each_var) {
+    for (auto &i : t.src.instrs()) {
+      if (i.getName()[0] != '%')
+        continue;
+      auto I = tgt_instrs.find(i.getName());
+      if (I == tgt_instrs.end())
+        return Exhaustive::Skipped;
+      cmp_vars.emplace_back(&i, I->second);
+    }
+  }
+
+  enum InputKind { Normal, Undef, Poison };
+  // see screen()
+  pair<unsigned, BugKind> best(UINT_MAX, NoBug);
+  map<string, pair<InputKind, APInt>> witness;
+  // The SMT encoding folds some operations whose result doesn't matter as
+  // they are UB (e.g., x / 0 is 0 if the 0 is a literal), and values after UB
+  // are still compared in check_each_var mode; without UB, runs are exact.
+  bool exact = true;
+  auto check_ub = [&](bool ub) { exact &= cmp_vars.empty() || !ub; };
+
+  // values and poison, bit-sliced; each input in 'poison' is poison in every
+  // lane, and the others count through their values over the lanes
+  auto num_vars = vars.size();
+  for (uint64_t poison = 0; poison >> num_vars == 0; ++poison) {
+    unsigned free_bits = 0, idx = 0;
+    bool skip = false;
+    for (auto &[name, var] : vars) {
+      if ((poison >> idx++) & 1)
+        skip |= !var.second || config::disable_poison_input;
+      else
+        free_bits += var.first;
+    }
+    if (skip)
+      continue;
+
+    uint64_t num_blocks = 1ull << (max(free_bits, 6u) - 6);
+    for (uint64_t block = 0; block != num_blocks; ++block) {
+      unordered_map<string, SlicedVal> inputs;
+      unsigned bit = 0;
+      idx = 0;
+      for (auto &[name, var] : vars) {
+        BitSlice v(var.first);
+        uint64_t p = 0;
+        if ((poison >> idx++) & 1) {
+          p = UINT64_MAX;
+        } else {
+          // lanes past the number of assignments repeat the first ones
+          for (unsigned i = 0; i != var.first; ++i, ++bit) {
+            v[i] = bit < 6 ? lane_bits[bit]
+                           : ((block >> (bit - 6)) & 1 ? UINT64_MAX : 0);
+          }
+        }
+        inputs.emplace(name, SlicedVal(move(v), p));
+      }
+
+      SlicedInterpreter src(t.src, inputs), tgt(t.tgt, inputs);
+      try {
+        src.run();
+        tgt.run();
+      } catch (UnsupportedEval&) {
+        return Exhaustive::Skipped;
+      }
+      // if only one returns, the SMT check reports it
+      auto *src_ret = src.returnVal(), *tgt_ret = tgt.returnVal();
+      if (!src_ret != !tgt_ret)
+        return Exhaustive::Skipped;
+      check_ub(src.getUB() | tgt.getUB());
+
+      pair<unsigned, BugKind> bug(0, NoBug);
+      uint64_t lanes = 0;
+      for (auto [sv, tv] : cmp_vars) {
+        auto *a = src.get(*sv), *b = tgt.get(*tv);
+        if (!a || !b)
+          return Exhaustive::Skipped;
+        if ((lanes = ~a->poison & b->poison)) {
+          bug.second = MorePoisonous;
+          break;
+        }
+        if ((lanes = ~a->poison & ~a->v.eq(b->v))) {
+          bug.second = ValueMismatch;
+          break;
+        }
+        ++bug.first;
+      }
+
+      uint64_t defined = ~src.getUB();
+      if (!lanes && src_ret) {
+        if ((lanes = defined & tgt.getUB()))
+          bug.second = MoreDefined;
+        else if ((lanes = defined & ~src_ret->poison & tgt_ret->poison))
+          bug.second = MorePoisonous;
+        else if ((lanes = defined & ~src_ret->poison &
+                          ~src_ret->v.eq(tgt_ret->v)))
+          bug.second = ValueMismatch;
+      }
+
+      if (!lanes || bug >= best)
+        continue;
+
+      best = bug;
+      witness.clear();
+      auto lane = num_trailing_zeros(lanes);
+      for (auto &[name, val] : inputs) {
+        witness.try_emplace(name, val.poison ? Poison : Normal,
+                            val.v.lane(lane));
+      }
+    }
+  }
+
+  // undef, one assignment at a time; the source's undef values are
+  // universally quantified, so each of its values must be refined
+  auto refines_all = [](const ConcreteSet &src, const ConcreteSet &tgt) {
+    auto is_poison = [](auto &v) { return v.poison; };
+    if (any_of(src.begin(), src.end(), is_poison))
+      return NoBug;
+    if (any_of(tgt.begin(), tgt.end(), is_poison))
+      return MorePoisonous;
+    vector<const APInt*> vals;
+    for (auto &v : src) {
+      vals.emplace_back(&v.v);
+    }
+    auto lt = [](const APInt *a, const APInt *b) { return a->ult(*b); };
+    sort(vals.begin(), vals.end(), lt);
+    for (auto &v : tgt) {
+      if (!binary_search(vals.begin(), vals.end(), &v.v, lt))
+        return ValueMismatch;
+    }
+    return NoBug;
+  };
+
+  // an input's kinds: its values, then undef, then poison
+  vector<uint64_t> num_kinds;
+  uint64_t num_assignments = 1;
+  bool has_undef = false;
+  for (auto &[name, var] : vars) {
+    auto &[bits, in] = var;
+    bool undef = in && !config::disable_undef_input;
+    has_undef |= undef;
+    num_kinds.emplace_back((1ull << bits) + undef +
+                           (undef && !config::disable_poison_input));
+    if (num_assignments > max_undef_assignments / num_kinds.back())
+      return Exhaustive::Skipped;
+    num_assignments *= num_kinds.back();
+  }
+
+  unsigned steps = 0;
+  vector<uint64_t> kinds(num_vars);
+  for (uint64_t n = 0; has_undef && n != num_assignments; ++n) {
+    bool any_undef = false;
+    uint64_t rest = n;
+    unsigned idx = 0;
+    for (auto &[name, var] : vars) {
+      kinds[idx] = rest % num_kinds[idx];
+      rest /= num_kinds[idx];
+      any_undef |= kinds[idx++] == 1ull << var.first;
+    }
+    if (!any_undef)
+      continue;
+
+    unordered_map<string, APInt> inputs;
+    Interpreter src(t.src, inputs), tgt(t.tgt, inputs);
+    map<string, pair<InputKind, APInt>> assignment;
+    idx = 0;
+    for (auto &[name, var] : vars) {
+      unsigned bits = var.first;
+      uint64_t k = kinds[idx++];
+      if (k >> bits == 0) {
+        inputs.emplace(name, APInt(bits, k));
+        assignment.try_emplace(name, Normal, APInt(bits, k));
+        continue;
+      }
+      auto kind = k == 1ull << bits ? Undef : Poison;
+      assignment.try_emplace(name, kind, APInt(bits));
+      if (kind == Undef) {
+        src.setUndef(name);
+        tgt.setUndef(name);
+      } else {
+        src.setPoison(name);
+        tgt.setPoison(name);
+      }
+    }
+
+    // if there's a bug already, report it rather than give up
+    bool done = false;
+    try {
+      auto budget = best.second == NoBug ? max_undef_steps
+                                         : max_undef_steps_after_bug;
+      src.setMaxSteps(budget - min(steps, budget));
+      src.run();
+      steps += src.numSteps();
+      tgt.setMaxSteps(budget - min(steps, budget));
+      tgt.run();
+      steps += tgt.numSteps();
+    } catch (UnsupportedEval&) {
+      done = true;
+    }
+    done |= src.isNondet() || tgt.isNondet() ||
+            src.returnVals().empty() != tgt.returnVals().empty();
+    if (done) {
+      if (best.second == NoBug)
+        return Exhaustive::Skipped;
+      break;
+    }
+    check_ub(src.isUB() || tgt.isUB());
+
+    pair<unsigned, BugKind> bug(0, NoBug);
+    for (auto [sv, tv] : cmp_vars) {
+      bug.second = refines_all(src.getAll(*sv), tgt.getAll(*tv));
+      if (bug.second != NoBug)
+        break;
+      ++bug.first;
+    }
+    if (bug.second == NoBug && !src.returnVals().empty() && !src.isUB())
+      bug.second = tgt.isUB() ? MoreDefined
+                              : refines_all(src.returnVals(),
+                                            tgt.returnVals());
+
+    if (bug.second != NoBug && bug < best) {
+      best = bug;
+      witness = move(assignment);
+    }
+  }
+
+  if (best.second == NoBug)
+    return exact ? Exhaustive::Correct : Exhaustive::Skipped;
+
+  pin = true;
+  for (auto &[name, var] : vars) {
+    auto &[bits, in] = var;
+    auto &[kind, val] = witness.at(name);
+    if (kind == Normal)
+      pin &= expr::mkVar(name.c_str(), bits) == expr::mkAPInt(val);
+    if (in)
+      pin &= in->getTyVar() == (kind == Normal ? 0 : kind == Undef ? 1 : 2);
+  }
+  return Exhaustive::Incorrect;
+}
+
+// With the inputs pinned by screen(), reports the first query that fails
+// under the pin; these are cheap, since the inputs are constants. Otherwise,
+// it's a regular check.
+static void check_pinned(const expr &pre, const expr *pin,
+                         const vector<Solver::E> &queries) {
+  if (!pin) {
+    Solver::check(pre, queries);
+    return;
+  }
+
+  for (auto &q : queries) {
+    Result r;
+    {
+      PooledSolver s;
+      s->add(pre && *pin && q.query);
+      r = s->check();
+    }
+    if (r.isSat()) {
+      q.report(r);
+      return;
+    }
+  }
+}
+
 static void check_refinement(Errors &errs, Transform &t,
                              State &src_state, State &tgt_state,
                              const Value *var, const Type &type,
                              const expr &dom_a, const State::ValTy &ap,
                              const expr &dom_b, const State::ValTy &bp,
-                             bool check_each_var) {
+                             bool check_each_var, const expr *pin) {
   auto &a = ap.first;
   auto &b = bp.first;
 
@@ -227,6 +881,8 @@ static void check_refinement(Errors &errs, Transform &t,
   auto err = [&](const Result &r, bool print_var, const char *msg) {
     error(errs, src_state, tgt_state, r, print_var, var, type, a, b, msg,
           check_each_var);
+    if (r.isSat())
+      counterexample_db.add(t, r.getModel());
   };
 
   expr pre = src_state.getPre() && tgt_state.getPre();
@@ -241,20 +897,44 @@ static void check_refinement(Errors &errs, Transform &t,
                          return a.non_poison && a.value != b.value;
                        }, &expr::mk_or, a, b);
 
-  Solver::check({
-    { pre && preprocess(t, qvars, ap.second, dom_a.notImplies(dom_b)),
-      [&](const Result &r) {
-        err(r, false, "Source is more defined than target");
-      }},
-    { pre && preprocess(t, qvars, ap.second, dom_a && poison_cnstr),
-      [&](const Result &r) {
-        err(r, true, "Target is more poisonous than source");
-      }},
-    { pre && preprocess(t, qvars, ap.second, dom_a && value_cnstr),
-      [&](const Result &r) {
-        err(r, true, "Value mismatch");
-      }}
-  });
+  if (!config::split_undef_instances) {
+    check_pinned(pre, pin, {
+      { preprocess(t, qvars, ap.second, dom_a.notImplies(dom_b)),
+        [&](const Result &r) {
+          err(r, false, "Source is more defined than target");
+        }, "more defined" },
+      { preprocess(t, qvars, ap.second, dom_a && poison_cnstr),
+        [&](const Result &r) {
+          err(r, true, "Target is more poisonous than source");
+        }, "more poisonous" },
+      { preprocess(t, qvars, ap.second, dom_a && value_cnstr),
+        [&](const Result &r) {
+          err(r, true, "Value mismatch");
+        }, "value mismatch" }
+    });
+    return;
+  }
+
+  // Check each instance on its own. They keep the order of the checks above,
+  // so the first failing instance is reported as before; its model assigns
+  // the undef type variables through the instance's tags.
+  vector<Solver::E> queries;
+  auto add = [&](expr &&e, function<void(const Result&)> report,
+                 const char *kind) {
+    for (auto &inst : preprocess_instances(t, qvars, ap.second, move(e))) {
+      queries.push_back({ move(inst), report, kind });
+    }
+  };
+  add(dom_a.notImplies(dom_b), [&](const Result &r) {
+    err(r, false, "Source is more defined than target");
+  }, "more defined");
+  add(dom_a && poison_cnstr, [&](const Result &r) {
+    err(r, true, "Target is more poisonous than source");
+  }, "more poisonous");
+  add(dom_a && value_cnstr, [&](const Result &r) {
+    err(r, true, "Value mismatch");
+  }, "value mismatch");
+  check_pinned(pre, pin, queries);
 }
 
 
@@ -275,60 +955,124 @@ TransformVerify::TransformVerify(Transform &t, bool check_each_var) :
 }
 
 Errors TransformVerify::verify() const {
-  Value::reset_gbl_id();
-  State src_state(t.src, true), tgt_state(t.tgt, false);
-
-  try {
-    sym_exec(src_state);
-    sym_exec(tgt_state);
-  } catch (LoopInCFGDetected&) {
-    return "Loops are not supported yet! Skipping function.";
-  } catch (OutOfMemory&) {
-    return "Out of memory; skipping function.";
+  // Small transforms are decided by running them on every input.
+  // A concrete counterexample is confirmed with the inputs pinned first, so
+  // it doesn't wait on the full queries. If there are several bugs, the one
+  // reported may not be the one the full check would find first.
+  optional<expr> pin;
+  expr exhaustive_pin;
+  switch (exhaustive(t, check_each_var, tgt_instrs, exhaustive_pin)) {
+  case Exhaustive::Correct:
+    return {};
+  case Exhaustive::Incorrect:
+    pin = move(exhaustive_pin);
+    break;
+  case Exhaustive::Skipped:
+    pin = screen(t, check_each_var, tgt_instrs);
+    break;
   }
 
-  Errors errs;
+  // Runs the checks; with 'slice', sets 'sliced' if it skipped instructions.
+  auto run = [&](bool slice, bool &sliced) -> Errors {
+    Value::reset_gbl_id();
+    State src_state(t.src, true), tgt_state(t.tgt, false);
+
+    try {
+      sliced = sym_exec(src_state, slice) +
+               sym_exec(tgt_state, slice, &src_state) != 0;
+    } catch (LoopInCFGDetected&) {
+      return "Loops are not supported yet! Skipping function.";
+    } catch (OutOfMemory&) {
+      return "Out of memory; skipping function.";
+    }
 
-  if (check_each_var) {
-    for (auto &[var, val] : src_state.getValues()) {
-      auto &name = var->getName();
-      if (name[0] != '%' || !dynamic_cast<const Instr*>(var))
-        continue;
+    auto check = [&](const expr *pin) {
+      Errors errs;
+      if (check_each_var) {
+        for (auto &[var, val] : src_state.getValues()) {
+          auto &name = var->getName();
+          if (name[0] != '%' || !dynamic_cast<const Instr*>(var))
+            continue;
+
+          // TODO: add data-flow domain tracking for Alive, but not for TV
+          check_refinement(errs, t, src_state, tgt_state, var, var->getType(),
+                           true, val, true, tgt_state.at(*tgt_instrs.at(name)),
+                           check_each_var, pin);
+          if (errs)
+            return errs;
+        }
+      }
+
+      if (src_state.fnReturned() != tgt_state.fnReturned()) {
+        if (src_state.fnReturned())
+          errs.add("Source returns but target doesn't");
+        else
+          errs.add("Target returns but source doesn't");
+
+      } else if (src_state.fnReturned()) {
+        check_refinement(errs, t, src_state, tgt_state, nullptr,
+                         t.src.getType(), src_state.returnDomain(),
+                         src_state.returnVal(), tgt_state.returnDomain(),
+                         tgt_state.returnVal(), check_each_var, pin);
+      }
+      return errs;
+    };
 
-      // TODO: add data-flow domain tracking for Alive, but not for TV
-      check_refinement(errs, t, src_state, tgt_state, var, var->getType(),
-                       true, val, true, tgt_state.at(*tgt_instrs.at(name)),
-                       check_each_var);
-      if (errs)
+    if (pin) {
+      if (auto errs = check(&*pin))
         return errs;
     }
-  }
+    return check(nullptr);
+  };
 
-  if (src_state.fnReturned() != tgt_state.fnReturned()) {
-    if (src_state.fnReturned())
-      errs.add("Source returns but target doesn't");
-    else
-      errs.add("Target returns but source doesn't");
+  auto gave_up = [](const Errors &errs) {
+    return errs.isTimeout() || errs.isBudgetExceeded() || errs.isOOM() ||
+           errs.isInvalidExpr();
+  };
 
-  } else if (src_state.fnReturned()) {
-    check_refinement(errs, t, src_state, tgt_state, nullptr, t.src.getType(),
-                     src_state.returnDomain(), src_state.returnVal(),
-                     tgt_state.returnDomain(), tgt_state.returnVal(),
-                     check_each_var);
+  // Only the return value is compared without check_each_var, so the other
+  // instructions are sliced away. The counterexample prints every value,
+  // though, so a failure is checked again without slicing to report it in
+  // full; the sliced one stands if that check gives up.
+  bool sliced;
+  auto errs = run(!check_each_var, sliced);
+  if (sliced && errs && !gave_up(errs)) {
+    if (auto full = run(false, sliced); !gave_up(full))
+      return full;
   }
-
   return errs;
 }
 
 
-TypingAssignments::TypingAssignments(const expr &e) {
+TypingAssignments::TypingAssignments(const expr &e, expr &&cost)
+  : cost(move(cost)) {
   if (e.isTrue()) {
     has_only_one_solution = true;
   } else {
     EnableSMTQueriesTMP tmp;
     s.add(e);
+    next();
+  }
+}
+
+void TypingAssignments::next() {
+  // past the largest cost representable, the bound would wrap around
+  while ((max_cost >> cost.bits()) == 0) {
+    {
+      SolverPush push(s);
+      s.add(cost.ule(max_cost));
+      r = s.check();
+    }
+    if (!r.isUnsat())
+      return;
+
+    // no typings left in this bucket; are there more expensive ones?
     r = s.check();
+    if (!r.isSat())
+      return;
+    max_cost *= 2;
   }
+  r = s.check();
 }
 
 TypingAssignments::operator bool() const {
@@ -341,8 +1085,7 @@ void TypingAssignments::operator++(void) {
   } else {
     EnableSMTQueriesTMP tmp;
     s.block(r.getModel(), /*minimize=*/true);
-    r = s.check();
-    assert(!r.isUnknown());
+    next();
   }
 }
 
@@ -371,14 +1114,121 @@ TypingAssignments TransformVerify::getTypings() const {
       c &= i.eqType(*tgt_instrs.at(i.getName()));
     }
   }
-  return { move(c) };
+  return { move(c), t.src.getTypeCost() + t.tgt.getTypeCost() };
 }
 
 void TransformVerify::fixupTypes(const TypingAssignments &ty) {
   if (ty.has_only_one_solution)
     return;
-  t.src.fixupTypes(ty.r.getModel());
-  t.tgt.fixupTypes(ty.r.getModel());
+  fixupTypes(ty.r.getModel());
+}
+
+void TransformVerify::fixupTypes(const Model &m) {
+  t.src.fixupTypes(m);
+  t.tgt.fixupTypes(m);
+}
+
+Errors TransformVerify::verifyParallel(unsigned num_threads, ostream &os) {
+  auto types = getTypings();
+  if (!types)
+    return types.timedOut() ? timeout_error() : "Doesn't type check!";
+
+  if (types.has_only_one_solution) {
+    auto errs = verify();
+    if (!errs)
+      os << "\rDone: 1/1" << flush;
+    return errs;
+  }
+
+  // Enumerate all typings first: the workers translate the models out of our
+  // context, which must not be in use meanwhile
+  vector<Result> models;
+  {
+    EnableSMTQueriesTMP tmp;
+    while (types.r.isSat()) {
+      types.s.block(types.r.getModel(), /*minimize=*/true);
+      models.emplace_back(move(types.r));
+      types.next();
+    }
+  }
+  bool timedout = types.timedOut();
+
+  auto &main_ctx = ctx;
+  auto *budget = TimeBudget::current();
+  auto *account = MemoryAccount::current();
+  unsigned n = models.size();
+  num_threads = min(num_threads, n);
+
+  // Workers stop taking typings after the first failure, and those still
+  // verifying a later typing are canceled through their budgets (which
+  // interrupt the running query; see smt::TimeBudget).
+  mutex mtx;
+  unsigned next = 0, done = 0;
+  unsigned failed = n;
+  Errors failed_errs;
+  vector<unsigned> current(num_threads, n);
+  vector<TimeBudget*> budgets(num_threads, nullptr);
+
+  vector<thread> threads;
+  for (unsigned w = 0; w != num_threads; ++w) {
+    threads.emplace_back([&, w]() {
+      smt_initializer smt_init;
+      solver_profile_transform(t.name);
+      TimeBudget worker_budget(budget);
+      MemoryAccount::Scope account_scope(account);
+      Transform copy = t.dup();
+      TransformVerify tv(copy, check_each_var);
+
+      unique_lock<mutex> lock(mtx);
+      budgets[w] = &worker_budget;
+      while (next < failed) {
+        unsigned i = current[w] = next++;
+        lock.unlock();
+
+        auto r = Result::translate(models[i], main_ctx);
+        tv.fixupTypes(r.getModel());
+        auto errs = tv.verify();
+
+        lock.lock();
+        if (i < failed) {
+          if (errs) {
+            failed = i;
+            failed_errs = move(errs);
+            for (unsigned j = 0; j != num_threads; ++j) {
+              if (budgets[j] && current[j] > i)
+                budgets[j]->cancel();
+            }
+          } else {
+            os << "\rDone: " << ++done << '/' << n << flush;
+          }
+        }
+      }
+      budgets[w] = nullptr;
+      lock.unlock();
+
+      // a cut that matters (i.e., not a cancellation) can only happen when no
+      // typing failed, and then the verdict depends on it
+      if (budget && worker_budget.exceeded())
+        budget->setCut();
+    });
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  if (failed < n)
+    return failed_errs;
+  return timedout ? timeout_error() : Errors();
+}
+
+Transform Transform::dup() const {
+  Transform copy;
+  copy.name = name;
+  copy.types = make_unique<TypeCopies>();
+  copy.src = src.dup(*copy.types);
+  copy.tgt = tgt.dup(*copy.types);
+  return copy;
 }
 
 void Transform::print(ostream &os, const TransformPrintOpts &opt) const {
@@ -395,4 +1245,71 @@ ostream& operator<<(ostream &os, const Transform &t) {
   return os;
 }
 
+
+TransformBatch::TransformBatch(unsigned first_timeout, double budget_secs,
+                               VerifyFn verify, ReportFn report)
+  : verify(move(verify)), report(move(report)),
+    start(chrono::steady_clock::now()), budget(budget_secs) {
+  phases.push_back({ first_timeout });
+  set_query_timeout(to_string(first_timeout));
+}
+
+bool TransformBatch::hasBudget() const {
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() < budget;
+}
+
+void TransformBatch::run(Transform &&t) {
+  auto errs = verify(t);
+  ++phases.back().runs;
+  if (errs.isTimeout()) {
+    retries.emplace_back(move(t), move(errs));
+  } else {
+    ++phases.back().resolved;
+    report(t, errs);
+  }
+}
+
+void TransformBatch::finish(ostream &os) {
+  while (!retries.empty() && hasBudget()) {
+    auto timeout = phases.back().timeout * 4;
+    phases.push_back({ timeout });
+    set_query_timeout(to_string(timeout));
+    os << "\nRetrying " << retries.size() << " transform(s) with a timeout of "
+       << timeout << " ms\n";
+
+    decltype(retries) todo;
+    swap(todo, retries);
+    for (auto &[t, errs] : todo) {
+      if (!hasBudget()) {
+        retries.emplace_back(move(t), move(errs));
+        continue;
+      }
+      errs = verify(t);
+      ++phases.back().runs;
+      if (errs.isTimeout()) {
+        retries.emplace_back(move(t), move(errs));
+      } else {
+        ++phases.back().resolved;
+        report(t, errs);
+      }
+    }
+  }
+
+  for (auto &[t, errs] : retries) {
+    report(t, errs);
+  }
+}
+
+void TransformBatch::printSummary(ostream &os) const {
+  os << "\n------------------ BATCH STATS ------------------\n";
+  for (unsigned i = 0, e = phases.size(); i != e; ++i) {
+    auto &p = phases[i];
+    os << (i == 0 ? "First pass" : "Retry " + to_string(i)) << " ("
+       << p.timeout << " ms): resolved " << p.resolved << " of " << p.runs
+       << '\n';
+  }
+  os << "Unresolved:  " << retries.size() << '\n';
+}
+
 }
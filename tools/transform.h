@@ -6,10 +6,15 @@
 #include "ir/function.h"
 #include "smt/solver.h"
 #include "util/errors.h"
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <set>
 #include <string>
 #include <ostream>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace tools {
 
@@ -20,24 +25,38 @@ struct TransformPrintOpts {
 
 struct Transform {
   std::string name;
+  // the types of a copy (see dup); the parser owns those of the original
+  std::unique_ptr<IR::TypeCopies> types;
   IR::Function src, tgt;
 
+  // A copy whose types can be fixed up independently of this transform's
+  Transform dup() const;
   void print(std::ostream &os, const TransformPrintOpts &opt) const;
   friend std::ostream& operator<<(std::ostream &os, const Transform &t);
 };
 
 
+// Enumerates the typings cheapest first (see IR::Type::getCost), so that
+// bugs show up on small types before slow queries over wide ones. The order
+// is by buckets of doubling cost; typings within a bucket come in any order.
 class TypingAssignments {
-  smt::Solver s;
+  // typing queries are small, and an incremental solver makes the push/pop
+  // of the cost bounds cheap
+  smt::Solver s{/*incremental=*/true};
   smt::Result r;
+  smt::expr cost;
+  uint64_t max_cost = 8;
   bool has_only_one_solution = false;
   bool is_unsat = false;
-  TypingAssignments(const smt::expr &e);
+  TypingAssignments(const smt::expr &e, smt::expr &&cost);
+  void next();
 
 public:
   bool operator!() const { return !(bool)*this; }
   operator bool() const;
   void operator++(void);
+  // the enumeration stopped because a query timed out
+  bool timedOut() const { return !has_only_one_solution && r.isUnknown(); }
 
   friend class TransformVerify;
 };
@@ -53,10 +72,64 @@ public:
   util::Errors verify() const;
   TypingAssignments getTypings() const;
   void fixupTypes(const TypingAssignments &ty);
+  void fixupTypes(const smt::Model &m);
+  // Enumerates the typings and verifies them on up to 'num_threads' workers,
+  // each with a copy of the transform (see Transform::dup) and its own SMT
+  // context. Prints "Done: i/N" to 'os' as typings finish. Returns the errors
+  // of the first failing typing in enumeration order; typings after it are
+  // canceled.
+  util::Errors verifyParallel(unsigned num_threads, std::ostream &os);
+};
+
+// Two-phase timeout scheduling for batch runs. All transforms first run with
+// a short query timeout; those that time out are retried at the end with
+// timeouts growing 4x per round until the time budget (counted from
+// construction) is used up. A transform that already started is allowed to
+// finish.
+class TransformBatch {
+public:
+  using VerifyFn = std::function<util::Errors(Transform &t)>;
+  using ReportFn = std::function<void(Transform &t, const util::Errors &errs)>;
+
+private:
+  VerifyFn verify;
+  ReportFn report;
+  std::vector<std::pair<Transform, util::Errors>> retries;
+  // per phase: timeout, transforms run, transforms resolved
+  struct Phase { unsigned timeout, runs = 0, resolved = 0; };
+  std::vector<Phase> phases;
+  std::chrono::steady_clock::time_point start;
+  double budget;
+
+  bool hasBudget() const;
+
+public:
+  TransformBatch(unsigned first_timeout, double budget_secs, VerifyFn verify,
+                 ReportFn report);
+  // First pass; 'report' is only called if the transform didn't time out
+  void run(Transform &&t);
+  // Retry rounds; afterwards every transform has been reported
+  void finish(std::ostream &os);
+  void printSummary(std::ostream &os) const;
 };
 
 smt::expr preprocess(Transform &t, const std::set<smt::expr> &qvars,
                        const std::set<smt::expr> &undef_qvars, smt::expr && e);
+// The disjuncts of preprocess(): one per instantiation of the inputs' undef
+// type variables, each tagged with the values it assigns them
+std::vector<smt::expr>
+preprocess_instances(Transform &t, const std::set<smt::expr> &qvars,
+                     const std::set<smt::expr> &undef_qvars, smt::expr &&e);
+
+// The error for a query or typing enumeration that gave up: out of memory if
+// the calling thread's job is over the memory limit (see smt::MemoryAccount),
+// "Budget exceeded" if its time budget (see smt::TimeBudget) cut a query
+// short, and "Timeout" otherwise
+const char* timeout_error();
+
+// Store the inputs of counterexamples in the given file, and try those of
+// earlier runs on new transforms first; empty string keeps them in memory
+void use_counterexample_db(std::string file);
 
 void error(util::Errors &errs, IR::State &src_state, IR::State &tgt_state,
                   const smt::Result &r, bool print_var, const IR::Value *var,
@@ -2,10 +2,12 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "llvm_util/utils.h"
+#include "smt/budget.h"
 #include "smt/smt.h"
 #include "smt/solver.h"
 #include "tools/transform.h"
 #include "util/config.h"
+#include "util/symexec.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
@@ -64,6 +66,90 @@ llvm::cl::opt<bool> opt_smt_verbose(
   "tv-smt-verbose", llvm::cl::desc("Alive: SMT verbose mode"),
   llvm::cl::init(false));
 
+llvm::cl::opt<string> opt_smt_cache(
+  "tv-smt-cache", llvm::cl::desc("Alive: cache SMT query results on disk"),
+  llvm::cl::value_desc("directory"));
+
+llvm::cl::opt<string> opt_cex_db(
+  "tv-cex-db",
+  llvm::cl::desc("Alive: keep the inputs of counterexamples on disk and try "
+                 "them first on later functions"),
+  llvm::cl::value_desc("file"));
+
+llvm::cl::opt<string> opt_smt_portfolio(
+  "tv-smt-portfolio",
+  llvm::cl::desc("Alive: race tactic pipelines on each query ('default' or "
+                 "tactic,tactic,..:tactic,..)"),
+  llvm::cl::value_desc("pipelines"));
+
+llvm::cl::opt<string> opt_smt_profile(
+  "tv-smt-profile",
+  llvm::cl::desc("Alive: write a JSON line per SMT query to this file"),
+  llvm::cl::value_desc("filename"));
+
+llvm::cl::opt<string> opt_smt_dump(
+  "tv-smt-dump",
+  llvm::cl::desc("Alive: save each SMT query as an .smt2 file"),
+  llvm::cl::value_desc("directory"));
+
+llvm::cl::opt<string> opt_smt_tactics(
+  "tv-smt-tactics",
+  llvm::cl::desc("Alive: tactic pipeline to use (tactic,tactic,..)"),
+  llvm::cl::value_desc("tactics"));
+
+llvm::cl::list<string> opt_smt_params(
+  "tv-smt-param", llvm::cl::desc("Alive: set a Z3 global parameter"),
+  llvm::cl::value_desc("name=value"));
+
+llvm::cl::opt<string> opt_smt_config(
+  "tv-smt-config",
+  llvm::cl::desc("Alive: load the tactics and Z3 params from a file"),
+  llvm::cl::value_desc("filename"));
+
+llvm::cl::opt<bool> opt_smt_incremental(
+  "tv-smt-incremental",
+  llvm::cl::desc("Alive: share a solver between the refinement queries"),
+  llvm::cl::init(false));
+
+llvm::cl::opt<bool> opt_smt_pool(
+  "tv-smt-pool",
+  llvm::cl::desc("Alive: reuse solvers across queries instead of creating them"),
+  llvm::cl::init(false));
+
+llvm::cl::opt<bool> opt_smt_parallel(
+  "tv-smt-parallel",
+  llvm::cl::desc("Alive: check the refinement queries concurrently"),
+  llvm::cl::init(false));
+
+llvm::cl::opt<bool> opt_smt_bench_incremental(
+  "tv-smt-bench-incremental",
+  llvm::cl::desc("Alive: time fresh vs incremental solving"),
+  llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> opt_smt_cegis(
+  "tv-smt-cegis",
+  llvm::cl::desc("Alive: solve quantified queries with a CEGIS loop instead "
+                 "of MBQI, trying up to this many candidates (0 = disabled)"),
+  llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> opt_batch_to(
+  "tv-batch-to",
+  llvm::cl::desc("Alive: verify all functions with this timeout first, and "
+                 "retry the ones that timed out at the end with growing "
+                 "timeouts"),
+  llvm::cl::init(0), llvm::cl::value_desc("ms"));
+
+llvm::cl::opt<unsigned> opt_fn_budget(
+  "tv-fn-budget",
+  llvm::cl::desc("Alive: wall-clock time budget per function; the remaining "
+                 "queries are canceled once it runs out (0 = unlimited)"),
+  llvm::cl::init(0), llvm::cl::value_desc("ms"));
+
+llvm::cl::opt<double> opt_batch_budget(
+  "tv-batch-budget",
+  llvm::cl::desc("Alive: time budget for -tv-batch-to"),
+  llvm::cl::init(600), llvm::cl::value_desc("seconds"));
+
 llvm::cl::opt<bool> opt_tactic_verbose(
   "tv-tactic-verbose", llvm::cl::desc("Alive: SMT Tactic verbose mode"),
   llvm::cl::init(false));
@@ -82,12 +168,31 @@ llvm::cl::opt<bool> opt_disable_undef_input(
   llvm::cl::desc("Alive: Assume function input cannot be undef"),
   llvm::cl::init(false));
 
+llvm::cl::opt<bool> opt_split_undef(
+  "tv-split-undef",
+  llvm::cl::desc("Alive: check each instantiation of the undef inputs' types "
+                 "as its own query"),
+  llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> opt_concrete_runs(
+  "tv-concrete-runs",
+  llvm::cl::desc("Alive: number of concrete runs of src and tgt to look for a "
+                 "counterexample before SMT (0 = disabled)"),
+  llvm::cl::init(0));
+
+llvm::cl::opt<unsigned> opt_exhaustive_bits(
+  "tv-exhaustive-bits",
+  llvm::cl::desc("Alive: verify by evaluating src and tgt on every input if "
+                 "the inputs have at most this many bits (0 = disabled)"),
+  llvm::cl::init(0));
+
 ostream *out;
 ofstream out_file;
 optional<smt::smt_initializer> smt_init;
 optional<llvm_util::initializer> llvm_util_init;
 TransformPrintOpts print_opts;
 unordered_map<string, pair<Function, unsigned>> fns;
+optional<TransformBatch> batch;
 
 
 struct TVPass : public llvm::FunctionPass {
@@ -114,17 +219,42 @@ struct TVPass : public llvm::FunctionPass {
     if (inserted)
       return false;
 
-    smt_init->reset();
     Transform t;
     t.src = move(old_fn->second.first);
     t.tgt = move(*fn);
+
+    if (batch) {
+      // the target is the source of the next comparison
+      old_fn->second.first = move(*llvm2alive(F));
+      batch->run(move(t));
+      return false;
+    }
+
+    report(t, verify(t));
+    old_fn->second.first = move(t.tgt);
+    return false;
+  }
+
+  static Errors verify(Transform &t) {
+    smt_init->reset();
+    smt::solver_profile_transform(t.src.getName());
     TransformVerify verifier(t, false);
     t.print(*out, print_opts);
+    smt::TimeBudget budget(opt_fn_budget);
+    smt::MemoryAccount memory;
+    auto errs = verifier.verify();
 
-    if (Errors errs = verifier.verify()) {
+    if (opt_smt_bench_incremental)
+      smt::solver_print_bench(*out);
+    return errs;
+  }
+
+  static void report(Transform &t, const Errors &errs) {
+    if (errs) {
       *out << "Transformation doesn't verify!\n" << errs << endl;
       if (opt_error_fatal &&
           !errs.isTimeout() &&
+          !errs.isBudgetExceeded() &&
           !errs.isInvalidExpr() &&
           !errs.isOOM() &&
           !errs.isLoopyCFG())
@@ -132,9 +262,6 @@ struct TVPass : public llvm::FunctionPass {
     } else {
       *out << "Transformation seems to be correct!\n\n";
     }
-
-    old_fn->second.first = move(t.tgt);
-    return false;
   }
 
   bool doInitialization(llvm::Module &module) override {
@@ -177,11 +304,41 @@ struct TVPass : public llvm::FunctionPass {
     
     smt::solver_print_queries(opt_smt_verbose);
     smt::solver_tactic_verbose(opt_tactic_verbose);
+    smt::solver_use_cache(opt_smt_cache);
+    use_counterexample_db(opt_cex_db);
+    smt::solver_incremental(opt_smt_incremental);
+    smt::solver_cegis(opt_smt_cegis);
+    smt::solver_pool(opt_smt_pool);
+    smt::solver_parallel(opt_smt_parallel);
+    if (!opt_smt_config.empty()) {
+      auto err = smt::load_solver_config(opt_smt_config);
+      if (!err.empty())
+        llvm::report_fatal_error("Alive2: " + err);
+    }
+    if (!opt_smt_tactics.empty() && !smt::solver_tactics(opt_smt_tactics))
+      llvm::report_fatal_error("Alive2: unknown tactic in -tv-smt-tactics");
+    for (auto &param : opt_smt_params) {
+      auto eq = param.find('=');
+      if (eq == string::npos)
+        llvm::report_fatal_error("Alive2: expected -tv-smt-param=name=value");
+      smt::set_solver_param(param.substr(0, eq), param.substr(eq + 1));
+    }
+    smt::solver_dump_queries(opt_smt_dump);
+    if (!smt::solver_profile(opt_smt_profile))
+      llvm::report_fatal_error("Alive2: couldn't open the -tv-smt-profile file");
+    if (!smt::solver_portfolio(opt_smt_portfolio))
+      llvm::report_fatal_error("Alive2: unknown tactic in -tv-smt-portfolio");
+    smt::solver_bench_incremental(opt_smt_bench_incremental);
     smt::set_query_timeout(to_string(opt_smt_to));
+    if (opt_batch_to)
+      batch.emplace(opt_batch_to, opt_batch_budget, verify, report);
     smt::set_memory_limit(opt_max_mem * 1024 * 1024);
     config::skip_smt = opt_smt_skip;
     config::symexec_print_each_value = opt_se_verbose;
     config::disable_undef_input = opt_disable_undef_input;
+    config::split_undef_instances = opt_split_undef;
+    config::concrete_runs = opt_concrete_runs;
+    config::exhaustive_bits = opt_exhaustive_bits;
     config::disable_poison_input = opt_disable_poison_input;
 
     llvm_util_init.emplace(*out);
@@ -190,9 +347,16 @@ struct TVPass : public llvm::FunctionPass {
   }
 
   bool doFinalization(llvm::Module&) override {
+    if (batch) {
+      batch->finish(*out);
+      batch->printSummary(*out);
+      batch.reset();
+    }
+
     static bool showed_stats = false;
-    if (opt_smt_stats && !showed_stats) {
+    if ((opt_smt_stats || !opt_smt_profile.empty()) && !showed_stats) {
       smt::solver_print_stats(*out);
+      sym_exec_print_stats(*out);
       showed_stats = true;
     }
     llvm_util_init.reset();
@@ -0,0 +1,329 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "util/apint.h"
+#include "util/compiler.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace util {
+
+APInt::APInt(unsigned bits, uint64_t val)
+  : words((bits + 63) / 64, 0), bw(bits) {
+  assert(bits > 0);
+  words[0] = val;
+  clearUnusedBits();
+}
+
+APInt APInt::fromBinary(unsigned bits, string_view str) {
+  APInt r(bits);
+  unsigned i = 0;
+  for (auto I = str.rbegin(), E = str.rend(); I != E && i < bits; ++I, ++i) {
+    assert(*I == '0' || *I == '1');
+    r.setBit(i, *I == '1');
+  }
+  return r;
+}
+
+APInt APInt::allOnes(unsigned bits) {
+  APInt r(bits);
+  fill(r.words.begin(), r.words.end(), UINT64_MAX);
+  r.clearUnusedBits();
+  return r;
+}
+
+void APInt::clearUnusedBits() {
+  if (auto rem = bw % 64)
+    words.back() &= UINT64_MAX >> (64 - rem);
+}
+
+void APInt::setBit(unsigned i, bool val) {
+  uint64_t mask = 1ull << (i % 64);
+  if (val)
+    words[i / 64] |= mask;
+  else
+    words[i / 64] &= ~mask;
+}
+
+bool APInt::isZero() const {
+  return all_of(words.begin(), words.end(), [](auto w) { return w == 0; });
+}
+
+bool APInt::isAllOnes() const {
+  return *this == allOnes(bw);
+}
+
+bool APInt::isUInt(uint64_t &n) const {
+  if (!all_of(words.begin() + 1, words.end(), [](auto w) { return w == 0; }))
+    return false;
+  n = words[0];
+  return true;
+}
+
+APInt APInt::operator+(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  APInt r(bw);
+  uint64_t carry = 0;
+  for (unsigned i = 0, e = numWords(); i != e; ++i) {
+    uint64_t sum = words[i] + carry;
+    carry = sum < carry;
+    r.words[i] = sum + rhs.words[i];
+    carry += r.words[i] < sum;
+  }
+  r.clearUnusedBits();
+  return r;
+}
+
+APInt APInt::operator-(const APInt &rhs) const {
+  return *this + rhs.neg();
+}
+
+APInt APInt::operator*(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  if (numWords() == 1)
+    return APInt(bw, words[0] * rhs.words[0]);
+
+  APInt r(bw), a = *this;
+  for (unsigned i = 0; i != bw; ++i) {
+    if (rhs.bit(i))
+      r = r + a;
+    a = a.shl(1);
+  }
+  return r;
+}
+
+APInt APInt::operator&(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  APInt r = *this;
+  for (unsigned i = 0, e = numWords(); i != e; ++i) {
+    r.words[i] &= rhs.words[i];
+  }
+  return r;
+}
+
+APInt APInt::operator|(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  APInt r = *this;
+  for (unsigned i = 0, e = numWords(); i != e; ++i) {
+    r.words[i] |= rhs.words[i];
+  }
+  return r;
+}
+
+APInt APInt::operator^(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  APInt r = *this;
+  for (unsigned i = 0, e = numWords(); i != e; ++i) {
+    r.words[i] ^= rhs.words[i];
+  }
+  return r;
+}
+
+APInt APInt::operator~() const {
+  APInt r = *this;
+  for (auto &w : r.words) {
+    w = ~w;
+  }
+  r.clearUnusedBits();
+  return r;
+}
+
+APInt APInt::neg() const {
+  return ~*this + APInt(bw, 1);
+}
+
+APInt APInt::udiv(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  if (rhs.isZero())
+    return allOnes(bw);
+  if (numWords() == 1)
+    return APInt(bw, words[0] / rhs.words[0]);
+
+  // long division, one bit at a time
+  APInt q(bw), r(bw);
+  for (unsigned i = bw; i-- > 0; ) {
+    r = r.shl(1);
+    r.setBit(0, bit(i));
+    if (!r.ult(rhs)) {
+      r = r - rhs;
+      q.setBit(i, true);
+    }
+  }
+  return q;
+}
+
+APInt APInt::urem(const APInt &rhs) const {
+  if (rhs.isZero())
+    return *this;
+  if (numWords() == 1)
+    return APInt(bw, words[0] % rhs.words[0]);
+  return *this - udiv(rhs) * rhs;
+}
+
+APInt APInt::sdiv(const APInt &rhs) const {
+  bool neg_a = isNegative(), neg_b = rhs.isNegative();
+  auto q = (neg_a ? neg() : *this).udiv(neg_b ? rhs.neg() : rhs);
+  return neg_a != neg_b ? q.neg() : q;
+}
+
+APInt APInt::srem(const APInt &rhs) const {
+  bool neg_a = isNegative();
+  auto r = (neg_a ? neg() : *this).urem(rhs.isNegative() ? rhs.neg() : rhs);
+  return neg_a ? r.neg() : r;
+}
+
+static unsigned shift_amount(const APInt &amount) {
+  uint64_t n;
+  if (!amount.isUInt(n) || n > amount.bits())
+    return amount.bits();
+  return n;
+}
+
+APInt APInt::shl(const APInt &rhs) const {
+  return shl(shift_amount(rhs));
+}
+
+APInt APInt::lshr(const APInt &rhs) const {
+  return lshr(shift_amount(rhs));
+}
+
+APInt APInt::ashr(const APInt &rhs) const {
+  return ashr(shift_amount(rhs));
+}
+
+APInt APInt::shl(unsigned amount) const {
+  APInt r(bw);
+  if (amount >= bw)
+    return r;
+
+  unsigned word_shift = amount / 64, bit_shift = amount % 64;
+  for (unsigned i = numWords(); i-- > word_shift; ) {
+    r.words[i] = words[i - word_shift] << bit_shift;
+    if (bit_shift && i > word_shift)
+      r.words[i] |= words[i - word_shift - 1] >> (64 - bit_shift);
+  }
+  r.clearUnusedBits();
+  return r;
+}
+
+APInt APInt::lshr(unsigned amount) const {
+  APInt r(bw);
+  if (amount >= bw)
+    return r;
+
+  unsigned word_shift = amount / 64, bit_shift = amount % 64;
+  for (unsigned i = 0, e = numWords() - word_shift; i != e; ++i) {
+    r.words[i] = words[i + word_shift] >> bit_shift;
+    if (bit_shift && i + word_shift + 1 < numWords())
+      r.words[i] |= words[i + word_shift + 1] << (64 - bit_shift);
+  }
+  return r;
+}
+
+APInt APInt::ashr(unsigned amount) const {
+  if (!isNegative())
+    return lshr(amount);
+  if (amount >= bw)
+    return allOnes(bw);
+  return ~(~*this).lshr(amount);
+}
+
+bool APInt::operator==(const APInt &rhs) const {
+  return bw == rhs.bw && words == rhs.words;
+}
+
+bool APInt::ult(const APInt &rhs) const {
+  assert(bw == rhs.bw);
+  for (unsigned i = numWords(); i-- > 0; ) {
+    if (words[i] != rhs.words[i])
+      return words[i] < rhs.words[i];
+  }
+  return false;
+}
+
+bool APInt::slt(const APInt &rhs) const {
+  bool neg_a = isNegative(), neg_b = rhs.isNegative();
+  return neg_a != neg_b ? neg_a : ult(rhs);
+}
+
+APInt APInt::zext(unsigned amount) const {
+  APInt r(bw + amount);
+  copy(words.begin(), words.end(), r.words.begin());
+  return r;
+}
+
+APInt APInt::sext(unsigned amount) const {
+  auto r = zext(amount);
+  if (isNegative()) {
+    for (unsigned i = bw, e = r.bw; i != e; ++i) {
+      r.setBit(i, true);
+    }
+  }
+  return r;
+}
+
+APInt APInt::extract(unsigned high, unsigned low) const {
+  assert(high >= low && high < bw);
+  auto shifted = lshr(low);
+  APInt r(high - low + 1);
+  copy(shifted.words.begin(), shifted.words.begin() + r.numWords(),
+       r.words.begin());
+  r.clearUnusedBits();
+  return r;
+}
+
+APInt APInt::concat(const APInt &rhs) const {
+  auto r = rhs.zext(bw);
+  auto hi = zext(rhs.bw).shl(rhs.bw);
+  return r | hi;
+}
+
+unsigned APInt::popcount() const {
+  unsigned n = 0;
+  for (auto w : words) {
+    for (; w; w &= w - 1) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+unsigned APInt::countLeadingZeros() const {
+  unsigned unused = numWords() * 64 - bw;
+  for (unsigned i = numWords(); i-- > 0; ) {
+    if (words[i])
+      return (numWords() - 1 - i) * 64 + num_leading_zeros(words[i]) - unused;
+  }
+  return bw;
+}
+
+unsigned APInt::countTrailingZeros() const {
+  for (unsigned i = 0, e = numWords(); i != e; ++i) {
+    if (words[i])
+      return min(i * 64 + num_trailing_zeros(words[i]), bw);
+  }
+  return bw;
+}
+
+APInt APInt::bswap() const {
+  assert(bw % 8 == 0);
+  APInt r(bw);
+  for (unsigned i = 0, e = bw / 8; i != e; ++i) {
+    for (unsigned j = 0; j != 8; ++j) {
+      r.setBit((e - 1 - i) * 8 + j, bit(i * 8 + j));
+    }
+  }
+  return r;
+}
+
+APInt APInt::bitreverse() const {
+  APInt r(bw);
+  for (unsigned i = 0; i != bw; ++i) {
+    r.setBit(bw - 1 - i, bit(i));
+  }
+  return r;
+}
+
+}
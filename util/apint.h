@@ -0,0 +1,83 @@
+#pragma once
+
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+// Fixed-width integer of arbitrary bit-width with wrap-around (modular)
+// semantics, like an SMT bit-vector numeral. Used to fold constants wider
+// than 64 bits without going through the SMT solver.
+class APInt {
+  std::vector<uint64_t> words; // least significant first
+  unsigned bw;
+
+  unsigned numWords() const { return words.size(); }
+  void clearUnusedBits();
+  bool isMinusSign() const { return bit(bw - 1); }
+
+public:
+  APInt(unsigned bits, uint64_t val = 0);
+  // from a binary string, most significant bit first
+  static APInt fromBinary(unsigned bits, std::string_view str);
+  static APInt allOnes(unsigned bits);
+
+  unsigned bits() const { return bw; }
+  bool bit(unsigned i) const { return (words[i / 64] >> (i % 64)) & 1; }
+  void setBit(unsigned i, bool val);
+  uint64_t lowWord() const { return words[0]; }
+
+  bool isZero() const;
+  bool isAllOnes() const;
+  bool isNegative() const { return isMinusSign(); }
+  // true if the value fits in 64 bits (zero extended)
+  bool isUInt(uint64_t &n) const;
+
+  APInt operator+(const APInt &rhs) const;
+  APInt operator-(const APInt &rhs) const;
+  APInt operator*(const APInt &rhs) const;
+  APInt operator&(const APInt &rhs) const;
+  APInt operator|(const APInt &rhs) const;
+  APInt operator^(const APInt &rhs) const;
+  APInt operator~() const;
+  APInt neg() const;
+
+  // division by zero follows SMT-LIB: udiv gives all ones, urem gives the
+  // dividend, and the signed versions derive from those
+  APInt udiv(const APInt &rhs) const;
+  APInt urem(const APInt &rhs) const;
+  APInt sdiv(const APInt &rhs) const;
+  APInt srem(const APInt &rhs) const;
+
+  // shift amounts >= bits() shift everything out
+  APInt shl(const APInt &rhs) const;
+  APInt lshr(const APInt &rhs) const;
+  APInt ashr(const APInt &rhs) const;
+  APInt shl(unsigned amount) const;
+  APInt lshr(unsigned amount) const;
+  APInt ashr(unsigned amount) const;
+
+  bool operator==(const APInt &rhs) const;
+  bool operator!=(const APInt &rhs) const { return !(*this == rhs); }
+  bool ult(const APInt &rhs) const;
+  bool ule(const APInt &rhs) const { return !rhs.ult(*this); }
+  bool slt(const APInt &rhs) const;
+  bool sle(const APInt &rhs) const { return !rhs.slt(*this); }
+
+  APInt zext(unsigned amount) const;
+  APInt sext(unsigned amount) const;
+  APInt extract(unsigned high, unsigned low) const;
+  APInt concat(const APInt &rhs) const;
+
+  unsigned popcount() const;
+  unsigned countLeadingZeros() const;
+  unsigned countTrailingZeros() const;
+  APInt bswap() const;
+  APInt bitreverse() const;
+};
+
+}
@@ -0,0 +1,309 @@
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "util/bitslice.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+namespace util {
+
+BitSlice BitSlice::splat(const APInt &v) {
+  BitSlice r(v.bits());
+  for (unsigned i = 0, e = v.bits(); i != e; ++i) {
+    r.w[i] = v.bit(i) ? UINT64_MAX : 0;
+  }
+  return r;
+}
+
+BitSlice BitSlice::select(uint64_t mask, const BitSlice &a, const BitSlice &b) {
+  assert(a.bits() == b.bits());
+  BitSlice r(a.bits());
+  for (unsigned i = 0, e = a.bits(); i != e; ++i) {
+    r.w[i] = (a.w[i] & mask) | (b.w[i] & ~mask);
+  }
+  return r;
+}
+
+APInt BitSlice::lane(unsigned l) const {
+  APInt r(bits());
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    r.setBit(i, (w[i] >> l) & 1);
+  }
+  return r;
+}
+
+void BitSlice::setLane(unsigned l, const APInt &v) {
+  assert(v.bits() == bits());
+  uint64_t mask = 1ull << l;
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    w[i] = v.bit(i) ? w[i] | mask : w[i] & ~mask;
+  }
+}
+
+uint64_t BitSlice::isZero() const {
+  uint64_t any = 0;
+  for (auto b : w) {
+    any |= b;
+  }
+  return ~any;
+}
+
+// ripple-carry adder
+static BitSlice add(const BitSlice &a, const BitSlice &b, uint64_t carry) {
+  assert(a.bits() == b.bits());
+  BitSlice r(a.bits());
+  for (unsigned i = 0, e = a.bits(); i != e; ++i) {
+    uint64_t x = a[i] ^ b[i];
+    r[i] = x ^ carry;
+    carry = (a[i] & b[i]) | (x & carry);
+  }
+  return r;
+}
+
+// adds 1 to the lanes in 'mask'
+static void increment(BitSlice &a, uint64_t mask) {
+  for (unsigned i = 0, e = a.bits(); i != e && mask; ++i) {
+    uint64_t carry = a[i] & mask;
+    a[i] ^= mask;
+    mask = carry;
+  }
+}
+
+static BitSlice shl_const(const BitSlice &a, unsigned amount) {
+  BitSlice r(a.bits());
+  for (unsigned i = amount, e = a.bits(); i < e; ++i) {
+    r[i] = a[i - amount];
+  }
+  return r;
+}
+
+BitSlice BitSlice::operator+(const BitSlice &rhs) const {
+  return add(*this, rhs, 0);
+}
+
+BitSlice BitSlice::operator-(const BitSlice &rhs) const {
+  return add(*this, ~rhs, UINT64_MAX);
+}
+
+BitSlice BitSlice::operator*(const BitSlice &rhs) const {
+  assert(bits() == rhs.bits());
+  BitSlice r(bits());
+  // shift-and-add, with partial products masked per lane
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    if (!rhs.w[i])
+      continue;
+    auto p = shl_const(*this, i);
+    for (auto &b : p.w) {
+      b &= rhs.w[i];
+    }
+    r = r + p;
+  }
+  return r;
+}
+
+BitSlice BitSlice::operator&(const BitSlice &rhs) const {
+  assert(bits() == rhs.bits());
+  BitSlice r = *this;
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    r.w[i] &= rhs.w[i];
+  }
+  return r;
+}
+
+BitSlice BitSlice::operator|(const BitSlice &rhs) const {
+  assert(bits() == rhs.bits());
+  BitSlice r = *this;
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    r.w[i] |= rhs.w[i];
+  }
+  return r;
+}
+
+BitSlice BitSlice::operator^(const BitSlice &rhs) const {
+  assert(bits() == rhs.bits());
+  BitSlice r = *this;
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    r.w[i] ^= rhs.w[i];
+  }
+  return r;
+}
+
+BitSlice BitSlice::operator~() const {
+  BitSlice r = *this;
+  for (auto &b : r.w) {
+    b = ~b;
+  }
+  return r;
+}
+
+BitSlice BitSlice::neg() const {
+  return BitSlice(bits()) - *this;
+}
+
+// restoring division; returns <quotient, remainder>
+static pair<BitSlice, BitSlice> divrem(const BitSlice &a, const BitSlice &b) {
+  auto bw = a.bits();
+  auto d = b.zext(1);
+  BitSlice q(bw), r(bw + 1);
+  for (unsigned i = bw; i-- > 0; ) {
+    r = shl_const(r, 1);
+    r[0] = a[i];
+    uint64_t ge = d.ule(r);
+    r = BitSlice::select(ge, r - d, r);
+    q[i] = ge;
+  }
+  // x / 0 = all ones and x % 0 = x, as the loop computes already
+  return { move(q), r.extract(bw - 1, 0) };
+}
+
+BitSlice BitSlice::udiv(const BitSlice &rhs) const {
+  return divrem(*this, rhs).first;
+}
+
+BitSlice BitSlice::urem(const BitSlice &rhs) const {
+  return divrem(*this, rhs).second;
+}
+
+BitSlice BitSlice::sdiv(const BitSlice &rhs) const {
+  uint64_t neg_a = isNegative(), neg_b = rhs.isNegative();
+  auto q = select(neg_a, neg(), *this).udiv(select(neg_b, rhs.neg(), rhs));
+  return select(neg_a ^ neg_b, q.neg(), q);
+}
+
+BitSlice BitSlice::srem(const BitSlice &rhs) const {
+  uint64_t neg_a = isNegative();
+  auto r = select(neg_a, neg(), *this).urem(select(rhs.isNegative(), rhs.neg(),
+                                                   rhs));
+  return select(neg_a, r.neg(), r);
+}
+
+// barrel shifter; 'fill' is shifted in
+static BitSlice shift(const BitSlice &a, const BitSlice &amount, bool left,
+                      uint64_t fill) {
+  auto bw = a.bits();
+  BitSlice r = a;
+  for (unsigned k = 0; k < bw && (1u << k) < bw; ++k) {
+    unsigned n = 1u << k;
+    BitSlice s(bw);
+    for (unsigned i = 0; i != bw; ++i) {
+      if (left)
+        s[i] = i >= n ? r[i - n] : fill;
+      else
+        s[i] = i + n < bw ? r[i + n] : fill;
+    }
+    r = BitSlice::select(amount[k], s, r);
+  }
+
+  BitSlice all(bw);
+  for (unsigned i = 0; i != bw; ++i) {
+    all[i] = fill;
+  }
+  return BitSlice::select(~amount.ult(BitSlice::splat(APInt(bw, bw))), all, r);
+}
+
+BitSlice BitSlice::shl(const BitSlice &rhs) const {
+  return shift(*this, rhs, true, 0);
+}
+
+BitSlice BitSlice::lshr(const BitSlice &rhs) const {
+  return shift(*this, rhs, false, 0);
+}
+
+BitSlice BitSlice::ashr(const BitSlice &rhs) const {
+  return shift(*this, rhs, false, isNegative());
+}
+
+uint64_t BitSlice::eq(const BitSlice &rhs) const {
+  return (*this ^ rhs).isZero();
+}
+
+uint64_t BitSlice::ult(const BitSlice &rhs) const {
+  assert(bits() == rhs.bits());
+  // borrow out of *this - rhs
+  uint64_t borrow = 0;
+  for (unsigned i = 0, e = bits(); i != e; ++i) {
+    borrow = (~w[i] & rhs.w[i]) | (~(w[i] ^ rhs.w[i]) & borrow);
+  }
+  return borrow;
+}
+
+uint64_t BitSlice::slt(const BitSlice &rhs) const {
+  auto a = *this, b = rhs;
+  a.w.back() = ~a.w.back();
+  b.w.back() = ~b.w.back();
+  return a.ult(b);
+}
+
+BitSlice BitSlice::zext(unsigned amount) const {
+  BitSlice r = *this;
+  r.w.resize(bits() + amount, 0);
+  return r;
+}
+
+BitSlice BitSlice::sext(unsigned amount) const {
+  BitSlice r = *this;
+  r.w.resize(bits() + amount, w.back());
+  return r;
+}
+
+BitSlice BitSlice::extract(unsigned high, unsigned low) const {
+  assert(high >= low && high < bits());
+  BitSlice r(high - low + 1);
+  copy(w.begin() + low, w.begin() + high + 1, r.w.begin());
+  return r;
+}
+
+BitSlice BitSlice::concat(const BitSlice &rhs) const {
+  BitSlice r = rhs;
+  r.w.insert(r.w.end(), w.begin(), w.end());
+  return r;
+}
+
+BitSlice BitSlice::popcount() const {
+  BitSlice r(bits());
+  for (auto b : w) {
+    increment(r, b);
+  }
+  return r;
+}
+
+BitSlice BitSlice::countLeadingZeros() const {
+  BitSlice r(bits());
+  uint64_t found = 0;
+  for (unsigned i = bits(); i-- > 0; ) {
+    found |= w[i];
+    increment(r, ~found);
+  }
+  return r;
+}
+
+BitSlice BitSlice::countTrailingZeros() const {
+  BitSlice r(bits());
+  uint64_t found = 0;
+  for (auto b : w) {
+    found |= b;
+    increment(r, ~found);
+  }
+  return r;
+}
+
+BitSlice BitSlice::bswap() const {
+  assert(bits() % 8 == 0);
+  BitSlice r(bits());
+  for (unsigned i = 0, e = bits() / 8; i != e; ++i) {
+    for (unsigned j = 0; j != 8; ++j) {
+      r.w[(e - 1 - i) * 8 + j] = w[i * 8 + j];
+    }
+  }
+  return r;
+}
+
+BitSlice BitSlice::bitreverse() const {
+  BitSlice r = *this;
+  reverse(r.w.begin(), r.w.end());
+  return r;
+}
+
+}
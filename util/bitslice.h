@@ -0,0 +1,72 @@
+#pragma once
+
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "util/apint.h"
+#include <cstdint>
+#include <vector>
+
+namespace util {
+
+// 64 fixed-width integers, one per lane, stored bit-sliced: word i has bit i
+// of every lane. Operations are circuits of bitwise operations on whole words,
+// so they evaluate all 64 lanes at once. Same semantics as APInt's lane by
+// lane. Lane masks (e.g., the result of comparisons) are plain words.
+class BitSlice {
+  std::vector<uint64_t> w; // least significant bit first
+
+public:
+  explicit BitSlice(unsigned bits) : w(bits, 0) {}
+  // every lane set to 'v'
+  static BitSlice splat(const APInt &v);
+  static BitSlice select(uint64_t mask, const BitSlice &a, const BitSlice &b);
+
+  unsigned bits() const { return w.size(); }
+  uint64_t& operator[](unsigned i) { return w[i]; }
+  uint64_t operator[](unsigned i) const { return w[i]; }
+  APInt lane(unsigned l) const;
+  void setLane(unsigned l, const APInt &v);
+
+  uint64_t isZero() const;
+  uint64_t isNegative() const { return w.back(); }
+
+  BitSlice operator+(const BitSlice &rhs) const;
+  BitSlice operator-(const BitSlice &rhs) const;
+  BitSlice operator*(const BitSlice &rhs) const;
+  BitSlice operator&(const BitSlice &rhs) const;
+  BitSlice operator|(const BitSlice &rhs) const;
+  BitSlice operator^(const BitSlice &rhs) const;
+  BitSlice operator~() const;
+  BitSlice neg() const;
+
+  // division by zero is as in APInt
+  BitSlice udiv(const BitSlice &rhs) const;
+  BitSlice urem(const BitSlice &rhs) const;
+  BitSlice sdiv(const BitSlice &rhs) const;
+  BitSlice srem(const BitSlice &rhs) const;
+
+  // shift amounts >= bits() shift everything out
+  BitSlice shl(const BitSlice &rhs) const;
+  BitSlice lshr(const BitSlice &rhs) const;
+  BitSlice ashr(const BitSlice &rhs) const;
+
+  uint64_t eq(const BitSlice &rhs) const;
+  uint64_t ult(const BitSlice &rhs) const;
+  uint64_t ule(const BitSlice &rhs) const { return ~rhs.ult(*this); }
+  uint64_t slt(const BitSlice &rhs) const;
+  uint64_t sle(const BitSlice &rhs) const { return ~rhs.slt(*this); }
+
+  BitSlice zext(unsigned amount) const;
+  BitSlice sext(unsigned amount) const;
+  BitSlice extract(unsigned high, unsigned low) const;
+  BitSlice concat(const BitSlice &rhs) const;
+
+  BitSlice popcount() const;
+  BitSlice countLeadingZeros() const;
+  BitSlice countTrailingZeros() const;
+  BitSlice bswap() const;
+  BitSlice bitreverse() const;
+};
+
+}
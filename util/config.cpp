@@ -9,5 +9,8 @@ bool symexec_print_each_value = false;
 bool skip_smt = false;
 bool disable_poison_input = false;
 bool disable_undef_input = false;
+bool split_undef_instances = false;
+unsigned concrete_runs = 0;
+unsigned exhaustive_bits = 0;
 
 }
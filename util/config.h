@@ -13,4 +13,14 @@ extern bool disable_poison_input;
 
 extern bool disable_undef_input;
 
+extern bool split_undef_instances;
+
+// number of concrete runs of src/tgt to look for a counterexample before SMT;
+// 0 (the default) disables them
+extern unsigned concrete_runs;
+
+// inputs with at most this many bits in total are verified by evaluating
+// src and tgt on every input instead of with SMT; 0 (the default) disables it
+extern unsigned exhaustive_bits;
+
 }
@@ -20,6 +20,8 @@ public:
   void add(std::string &&str);
   explicit operator bool() const { return !errs.empty(); }
   bool isTimeout() const;
+  // the time budget of the transform ran out (see smt::TimeBudget)
+  bool isBudgetExceeded() const;
   bool isInvalidExpr() const;
   bool isOOM() const;
   bool isLoopyCFG() const; // FIXME
@@ -0,0 +1,60 @@
+#pragma once
+
+// Copyright (c) 2018-present The Alive2 Authors.
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace util {
+
+// Map of bounded size that evicts the least recently used entry
+template <typename K, typename V>
+class LRUCache {
+  using Entry = std::pair<K, V>;
+  std::list<Entry> entries; // most recently used first
+  std::unordered_map<K, typename std::list<Entry>::iterator> index;
+  size_t max_size;
+
+public:
+  LRUCache(size_t max_size) : max_size(max_size) {}
+
+  // returns null if not found
+  V* find(const K &key) {
+    auto I = index.find(key);
+    if (I == index.end())
+      return nullptr;
+    entries.splice(entries.begin(), entries, I->second);
+    return &I->second->second;
+  }
+
+  V& insert(const K &key, V &&val) {
+    if (auto I = index.find(key); I != index.end()) {
+      entries.splice(entries.begin(), entries, I->second);
+      return I->second->second = std::move(val);
+    }
+
+    if (entries.size() == max_size) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+    entries.emplace_front(key, std::move(val));
+    index.emplace(key, entries.begin());
+    return entries.front().second;
+  }
+
+  void clear() {
+    index.clear();
+    entries.clear();
+  }
+
+  size_t size() const { return entries.size(); }
+
+  // most recently used first; doesn't count as a use
+  auto begin() const { return entries.begin(); }
+  auto end() const { return entries.end(); }
+};
+
+}
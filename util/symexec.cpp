@@ -3,9 +3,17 @@
 
 #include "util/symexec.h"
 #include "ir/function.h"
+#include "ir/instr.h"
 #include "ir/state.h"
 #include "util/config.h"
+#include <atomic>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace IR;
 using namespace util;
@@ -13,9 +21,78 @@ using namespace std;
 
 namespace util {
 
-void sym_exec(State &s) {
+static atomic<uint64_t> num_instrs = 0, num_sliced = 0;
+static atomic<uint64_t> num_tgt_instrs = 0, num_shared = 0;
+
+static string to_string(const Instr &i) {
+  ostringstream os;
+  i.print(os);
+  return os.str();
+}
+
+// The instruction of the source whose value 'i' can share: it must print the
+// same (name, operation, flags, types, and operand names), have operands that
+// are shared or the same inputs and constants, and not depend on undef. Only
+// instructions that just compute a value qualify; the others depend on the
+// memory or the control flow, or make a choice (freeze).
+static const Instr*
+shared_instr(const Instr &i, const State &src,
+             const unordered_map<string, const Instr*> &src_instrs,
+             const unordered_map<const Instr*, const Instr*> &shared) {
+  if (i.hasSideEffects() || dynamic_cast<const Freeze*>(&i) ||
+      dynamic_cast<const Phi*>(&i) || i.getType().isPtrType())
+    return nullptr;
+
+  auto I = src_instrs.find(i.getName());
+  if (I == src_instrs.end())
+    return nullptr;
+  auto &si = *I->second;
+  if (typeid(si) != typeid(i) || to_string(si) != to_string(i))
+    return nullptr;
+
+  auto ops = i.operands(), src_ops = si.operands();
+  if (ops.size() != src_ops.size())
+    return nullptr;
+  for (unsigned k = 0, e = ops.size(); k != e; ++k) {
+    auto *op = ops[k], *src_op = src_ops[k];
+    // pointers depend on the memory, which differs
+    if (op->getType().isPtrType() ||
+        op->getType().toString() != src_op->getType().toString())
+      return nullptr;
+
+    if (auto *op_i = dynamic_cast<const Instr*>(op)) {
+      auto I = shared.find(op_i);
+      if (I == shared.end() || I->second != src_op)
+        return nullptr;
+    } else if (dynamic_cast<const Instr*>(src_op) ||
+               dynamic_cast<const UndefValue*>(op) ||
+               op->getName() != src_op->getName()) {
+      return nullptr;
+    }
+  }
+
+  auto *val = src.find(si);
+  return val && val->second.empty() ? &si : nullptr;
+}
+
+unsigned sym_exec(State &s, bool slice, const State *src) {
   Function &f = const_cast<Function&>(s.getFn());
 
+  // target instruction -> source instruction it shares the value of
+  unordered_map<string, const Instr*> src_instrs;
+  unordered_map<const Instr*, const Instr*> shared;
+  if (src) {
+    for (auto &i : src->getFn().instrs()) {
+      src_instrs.emplace(i.getName(), &i);
+    }
+  }
+
+  // printing each value needs them all
+  slice &= !config::symexec_print_each_value;
+  unordered_set<const Instr*> relevant;
+  if (slice)
+    relevant = relevant_instrs(f);
+
   // add constants & inputs to State table first of all
   for (auto &l : { f.getConstants(), f.getInputs(), f.getUndefs() }) {
     for (const auto &v : l) {
@@ -25,18 +102,48 @@ void sym_exec(State &s) {
 
   s.exec(Value::voidVal);
 
+  unsigned sliced = 0;
   for (auto &bb : f.getBBs()) {
     if (!s.startBB(*bb))
       continue;
 
     for (auto &i : bb->instrs()) {
-      auto val = s.exec(i);
+      ++num_instrs;
+      if (slice && !relevant.count(&i)) {
+        ++num_sliced;
+        ++sliced;
+        continue;
+      }
+
+      const Instr *si = nullptr;
+      if (src) {
+        ++num_tgt_instrs;
+        si = shared_instr(i, *src, src_instrs, shared);
+      }
+
+      if (si) {
+        ++num_shared;
+        shared.emplace(&i, si);
+      }
+      auto &val = si ? s.bind(i, src->at(*si).first) : s.exec(i);
       auto &name = i.getName();
 
       if (config::symexec_print_each_value && name[0] == '%')
         cout << name << " = " << val << '\n';
     }
   }
+  return sliced;
+}
+
+void sym_exec_print_stats(ostream &os) {
+  os << fixed << setprecision(1);
+  if (uint64_t total = num_instrs, sliced = num_sliced; sliced)
+    os << "Sliced:      " << sliced << " of " << total
+       << " instructions not executed (" << (sliced * 100.0) / total << "%)\n";
+  if (uint64_t total = num_tgt_instrs, n = num_shared; n)
+    os << "Shared:      " << n << " of " << total
+       << " target instructions bound to source terms ("
+       << (n * 100.0) / total << "%)\n";
 }
 
 }
@@ -3,10 +3,23 @@
 // Copyright (c) 2018-present The Alive2 Authors.
 // Distributed under the MIT license that can be found in the LICENSE file.
 
+#include <ostream>
+
 namespace IR { class State; }
 
 namespace util {
 
-void sym_exec(IR::State &s);
+// With 'slice', instructions that can't change the return value, UB, or the
+// memory (see IR::relevant_instrs()) are skipped, and their values are missing
+// from the state. That's only sound if nothing else is checked.
+// With 'src', the state of the source after its execution, instructions
+// identical to one of the source's on the same operands are bound to its
+// value rather than executed, unless they depend on undef.
+// Returns the number of instructions skipped.
+unsigned sym_exec(IR::State &s, bool slice = false,
+                  const IR::State *src = nullptr);
+
+// how many instructions slicing skipped and how many were shared
+void sym_exec_print_stats(std::ostream &os);
 
 }